@@ -0,0 +1,380 @@
+/**
+ * CES-33 Final Project
+ *
+ *  Memory Manager Simulator - Translation Hot Path Benchmark
+ *
+ *  Felipe Tuyama de F. Barbosa
+ *	Luiz Angel Rocha Rafael
+ */
+
+/**
+ * 	Benchmark Includes
+ *
+ *	The simulator is compiled into this file without its main, so every
+ *	benchmark calls the very same functions the simulator uses.
+ */
+#define _POSIX_C_SOURCE 200809L
+#define MemoryManager_NoMain
+#define output_default "/dev/null"
+
+#include <time.h>
+#include <math.h>
+
+#ifdef BenchmarkFIFO
+#include "MemoryManager_FIFO.c"
+#define BenchmarkedName "FIFO"
+#else
+#include "MemoryManager_LRU.c"
+#define BenchmarkedName "LRU"
+#endif
+
+/**
+ * 	Benchmark Defines
+ */
+#define MaxSizesAmount		16
+#define MaxBaselineLines	1024
+#define ParseLinesAmount	(1 << 16)	// Trace lines formatted for the parsing benchmark
+#define WarmUpReferences	10000
+#define ZipfExponent		0.99
+#define LoopPagesAmount		(2*TLBEntriesAmount)
+#define Tolerance_default	20			// Allowed slowdown over the baseline (%)
+
+// Synthetic Traces
+#define UniformTrace		0
+#define ZipfTrace			1
+#define SequentialTrace		2
+#define LoopingTrace		3
+#define TracesAmount		4
+
+const char *traceNames[TracesAmount] = {"uniform", "zipf", "sequential", "looping"};
+const int defaultSizes[] = {1000, 100000, 1000000};
+
+/**
+ * 	Benchmark Structs
+ */
+// Benchmark Result
+typedef struct benchmarkResult {
+	char benchmark[32], trace[16];
+	long size;
+	double nsPerReference;
+} BenchmarkResult;
+
+/**
+ * 	Benchmark Global Variables
+ */
+int *_trace;
+long _traceLength;
+FILE *_output;
+char (*_traceLines)[MaxStringLength];
+
+BenchmarkResult _baseline[MaxBaselineLines];
+int _baselineLength;
+int _regressions;
+double _tolerance = Tolerance_default;
+
+/**
+ * 	Timing methods
+ */
+// Monotonic clock in nanoseconds
+double nowNanoseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+/**
+ * 	Synthetic Trace methods
+ */
+// Reproducible xorshift generator
+unsigned long long _seed = 88172645463325252ULL;
+unsigned long long nextRandom()
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 7;
+	_seed ^= _seed << 17;
+	return _seed;
+}
+
+// Generating a synthetic trace of virtual addresses
+void generateTrace(int type, long length)
+{
+	double zipfCDF[PagesAmount], sum = 0;
+	for (int i = 0; i < PagesAmount; i++)
+		sum += 1.0/pow(i + 1, ZipfExponent);
+	for (int i = 0; i < PagesAmount; i++)
+		zipfCDF[i] = (i ? zipfCDF[i-1] : 0) + 1.0/pow(i + 1, ZipfExponent)/sum;
+
+	_seed = 88172645463325252ULL + type;
+	_traceLength = length;
+	for (long i = 0; i < length; i++) {
+		int offset = nextRandom() % FrameBytesSize;
+		int pageNumber = 0;
+
+		if (type == UniformTrace)
+			pageNumber = nextRandom() % PagesAmount;
+		else if (type == ZipfTrace) {
+			// Binary search on the Zipf CDF (hot pages are spread over the space)
+			double u = (nextRandom() >> 11) * (1.0/9007199254740992.0);
+			int low = 0, high = PagesAmount - 1;
+			while (low < high) {
+				int mid = (low + high)/2;
+				if (zipfCDF[mid] < u)	low = mid + 1;
+				else					high = mid;
+			}
+			pageNumber = (low*97) % PagesAmount;
+		}
+		else if (type == SequentialTrace) {
+			// Walks the address space 16 bytes at a time
+			int virtualAddress = (i*16) % (PagesAmount*FrameBytesSize);
+			pageNumber = virtualAddress/FrameBytesSize;
+			offset = virtualAddress % FrameBytesSize;
+		}
+		else if (type == LoopingTrace)
+			pageNumber = i % LoopPagesAmount;
+
+		_trace[i] = pageNumber*FrameBytesSize + offset;
+	}
+
+	// Text lines for the parsing benchmark (reused cyclically)
+	for (long i = 0; i < ParseLinesAmount; i++)
+		snprintf(_traceLines[i], MaxStringLength, "%d\n", _trace[i % length]);
+}
+
+/**
+ * 	Simulator State methods
+ */
+// Fresh simulator state, warmed up with the start of the trace
+void resetSimulator(int warmUp)
+{
+	memoryManagerCreate(backingStore_default, NULL);	// Becomes the current context
+	for (long i = 0; i < warmUp && i < _traceLength; i++)
+		findFrameNumberSynchronous(_trace[i]/PagesAmount);
+}
+
+/**
+ * 	Benchmarks
+ */
+// Parsing trace lines
+long benchmarkParsing()
+{
+	int virtualAddress, writeValue;
+	char access;
+	long checksum = 0;
+	for (long i = 0; i < _traceLength; i++) {
+		parseLine(_traceLines[i & (ParseLinesAmount-1)], &virtualAddress, &access, &writeValue);
+		checksum += virtualAddress;
+	}
+	return checksum;
+}
+
+// Probing the TLB
+long benchmarkTLB()
+{
+	long checksum = 0;
+	for (long i = 0; i < _traceLength; i++)
+		checksum += findPageOnTLB(_trace[i]/PagesAmount);
+	return checksum;
+}
+
+// Walking the Page Table
+long benchmarkPageTable()
+{
+	long checksum = 0;
+	for (long i = 0; i < _traceLength; i++)
+		checksum += findPageOnPageTable(_trace[i]/PagesAmount);
+	return checksum;
+}
+
+// Choosing frames (free frame or victim) for every non resident page
+long benchmarkFrameChoice()
+{
+	long checksum = 0;
+	for (long i = 0; i < _traceLength; i++) {
+		int pageNumber = _trace[i]/PagesAmount;
+		if (findPageOnPageTable(pageNumber) == -1) {
+			int frameNumber = findFrameOnMemory(pageNumber);
+			setPageOnPageTable(pageNumber, frameNumber);
+			checksum += frameNumber;
+		}
+	}
+	return checksum;
+}
+
+// Reading pages from the backing store
+long benchmarkBackingStore()
+{
+	long checksum = 0;
+	for (long i = 0; i < _traceLength; i++) {
+		int pageNumber = _trace[i]/PagesAmount;
+		getBackingStorePage(pageNumber, pageNumber % FramesAmount);
+		checksum += _memory->frame[pageNumber % FramesAmount].PageContent[0];
+	}
+	return checksum;
+}
+
+// Writing output lines
+long benchmarkWriteOut()
+{
+	for (long i = 0; i < _traceLength; i++)
+		writeOut(_output, _trace[i], _trace[i], i & 127);
+	return _traceLength;
+}
+
+// Whole translation of every reference (TLB, Page Table, fault path)
+long benchmarkTranslation()
+{
+	long checksum = 0;
+	for (long i = 0; i < _traceLength; i++) {
+		int virtualAddress = _trace[i];
+		int frameNumber = findFrameNumberSynchronous(virtualAddress/PagesAmount);
+		checksum += _memory->frame[frameNumber].PageContent[virtualAddress & (PagesAmount-1)];
+	}
+	return checksum;
+}
+
+// Batched translation of every reference
+long benchmarkBatchTranslation()
+{
+	int physicalAddresses[TranslationBatch], values[TranslationBatch];
+	long checksum = 0;
+	for (long i = 0; i < _traceLength; i += TranslationBatch) {
+		int amount = _traceLength - i < TranslationBatch ? _traceLength - i : TranslationBatch;
+		translateBatch(amount, &_trace[i], NULL, NULL, physicalAddresses, values);
+		checksum += values[amount - 1];
+	}
+	return checksum;
+}
+
+typedef struct benchmark {
+	const char *name;
+	long (*run)();
+	int warmUp;
+} Benchmark;
+
+const Benchmark benchmarks[] = {
+	{"parseLine",				benchmarkParsing,		0},
+	{"findPageOnTLB",			benchmarkTLB,			WarmUpReferences},
+	{"findPageOnPageTable",		benchmarkPageTable,		WarmUpReferences},
+	{"findFrameOnMemory",		benchmarkFrameChoice,	0},
+	{"getBackingStorePage",		benchmarkBackingStore,	0},
+	{"writeOut",				benchmarkWriteOut,		0},
+	{"translation",				benchmarkTranslation,	0},
+	{"translateBatch",			benchmarkBatchTranslation,	0},
+};
+#define BenchmarksAmount (int)(sizeof(benchmarks)/sizeof(benchmarks[0]))
+
+/**
+ * 	Baseline methods
+ */
+// Loading a saved benchmark table (lines of this simulator only)
+void loadBaseline(char *baselinefile)
+{
+	FILE *baseline = fopen(baselinefile, "r");
+	if (baseline == NULL) {
+		fprintf(stderr, "No baseline %s, nothing to compare\n", baselinefile);
+		return;
+	}
+
+	char simulator[16], text[256];
+	while (fgets(text, sizeof(text), baseline) && _baselineLength < MaxBaselineLines) {
+		BenchmarkResult *entry = &_baseline[_baselineLength];
+		if (sscanf(text, "%15s %31s %15s %ld %lf", simulator, entry->benchmark,
+				entry->trace, &entry->size, &entry->nsPerReference) == 5
+			&& strcmp(simulator, BenchmarkedName) == 0)
+			_baselineLength++;
+	}
+	fclose(baseline);
+}
+
+// Comparing one result with the baseline
+void compareWithBaseline(BenchmarkResult *current)
+{
+	for (int i = 0; i < _baselineLength; i++) {
+		BenchmarkResult *entry = &_baseline[i];
+		if (strcmp(entry->benchmark, current->benchmark) || strcmp(entry->trace, current->trace)
+			|| entry->size != current->size)
+			continue;
+
+		double change = 100.0*(current->nsPerReference - entry->nsPerReference)/entry->nsPerReference;
+		if (change > _tolerance) {
+			fprintf(stderr, "SLOWER %s %s %s %ld: %.2f -> %.2f ns/ref (+%.0f%%)\n", BenchmarkedName,
+				current->benchmark, current->trace, current->size,
+				entry->nsPerReference, current->nsPerReference, change);
+			_regressions++;
+		}
+		return;
+	}
+}
+
+/**
+ * 	Main Benchmark
+ *
+ *	MemoryManager_Benchmark [-b baseline] [-t tolerance%] [sizes...]
+ */
+int main(int arc, char** argv)
+{
+	long sizes[MaxSizesAmount];
+	int sizesAmount = 0;
+
+	for (int i = 1; i < arc; i++) {
+		if (strcmp(argv[i], "-b") == 0 && i + 1 < arc)
+			loadBaseline(argv[++i]);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < arc)
+			_tolerance = atof(argv[++i]);
+		else if (sizesAmount < MaxSizesAmount)
+			sizes[sizesAmount++] = atol(argv[i]);
+	}
+	if (sizesAmount == 0)
+		for (int i = 0; i < (int)(sizeof(defaultSizes)/sizeof(defaultSizes[0])); i++)
+			sizes[sizesAmount++] = defaultSizes[i];
+
+	long maxSize = 0;
+	for (int i = 0; i < sizesAmount; i++)
+		if (sizes[i] > maxSize)
+			maxSize = sizes[i];
+	_trace = (int*)malloc(maxSize*sizeof(int));
+	_traceLines = malloc(ParseLinesAmount*sizeof(*_traceLines));
+	_output = fopen(output_default, "w");
+
+	printf("%-10s %-20s %-10s %10s %10s %14s\n",
+		"Simulator", "Benchmark", "Trace", "References", "ns/ref", "refs/s");
+
+	for (int s = 0; s < sizesAmount; s++)
+		for (int t = 0; t < TracesAmount; t++) {
+			generateTrace(t, sizes[s]);
+
+			for (int b = 0; b < BenchmarksAmount; b++) {
+				resetSimulator(benchmarks[b].warmUp);
+
+				double start = nowNanoseconds();
+				volatile long checksum = benchmarks[b].run();
+				double elapsed = nowNanoseconds() - start;
+				(void)checksum;
+
+				memoryManagerDestroy(_context);
+
+				BenchmarkResult current;
+				snprintf(current.benchmark, sizeof(current.benchmark), "%s", benchmarks[b].name);
+				snprintf(current.trace, sizeof(current.trace), "%s", traceNames[t]);
+				current.size = sizes[s];
+				current.nsPerReference = elapsed/sizes[s];
+
+				printf("%-10s %-20s %-10s %10ld %10.2f %14.0f\n", BenchmarkedName,
+					current.benchmark, current.trace, current.size,
+					current.nsPerReference, 1e9/current.nsPerReference);
+				fflush(stdout);
+				compareWithBaseline(&current);
+			}
+		}
+
+	free(_trace);
+	free(_traceLines);
+	fclose(_output);
+
+	if (_regressions > 0) {
+		fprintf(stderr, "%d benchmark(s) slower than the baseline\n", _regressions);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,520 @@
+/**
+ * CES-33 Final Project
+ *
+ *  Memory Manager Simulator - Concurrent Translation Engine
+ *
+ *  Felipe Tuyama de F. Barbosa
+ *	Luiz Angel Rocha Rafael
+ *
+ *	Many threads translate one trace on a single shared address space. The
+ *	Page Table is read without locks; page faults and writes lock the shard
+ *	of their page. Every thread has its own TLB and statistics, and full
+ *	memory is replaced by a shared CLOCK hand. Each frame has a sequence
+ *	number, odd while the frame is being replaced, so readers validate the
+ *	byte they read instead of locking the frame.
+ */
+
+/**
+ * 	Memory Manager Includes
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "libmemmgr.h"
+#include "MemoryManager_Trace.h"
+
+/**
+ * 	Memory Manager Defines
+ */
+// Max Number Definitions
+#define MaxThreads			64
+
+// Virtual Memory Pages
+#define PagesAmount			256
+#define TLBEntriesAmount	16
+
+// Physical Memory RAM
+#define FramesAmount		256
+#define FrameBytesSize		256
+
+// Concurrency
+#define CacheLineSize		64
+#define PageTableShards		16		// Locks for faults and writes, one per page % PageTableShards
+#define ChunkReferences		1024	// Consecutive references taken by a thread at a time
+
+// Wait of a CLOCK hand without a victim after two turns, doubled every two turns
+#define BackoffMinNanoseconds	1000
+#define BackoffMaxNanoseconds	1000000
+
+// Page Table Entries: frame number plus valid/referenced/dirty bits in one word
+#define EntryValid			0x80000000u
+#define EntryReferenced		0x40000000u		// Second chance of the CLOCK hand
+#define EntryDirty			0x20000000u
+#define EntryFrameMask		0x00FFFFFFu
+
+//Files
+#define inputfile_default 	"addresses.txt"
+#define backingStore_default "BACKING_STORE.bin"
+#define backingStoreCopy_default "BACKING_STORE_out.bin"
+#define result_default 		"result.txt"
+
+/**
+ * 	Memory Manager Structs
+ */
+// Shard - Lock of the pages with the same page % PageTableShards
+typedef struct shard {
+	pthread_mutex_t mutex;
+} __attribute__((aligned(CacheLineSize))) Shard;
+
+// Address Space - Page Table and Memory shared by every thread
+typedef struct addressSpace {
+	unsigned int entry[PagesAmount];
+	Shard shard[PageTableShards];
+
+	char frame[FramesAmount][FrameBytesSize];
+	int framePage[FramesAmount];				// Page held by each frame (-1 while replaced)
+	unsigned int sequence[FramesAmount];		// Odd while the frame is replaced
+
+	// Free frames taken so far, CLOCK hand and next trace chunk (own cache lines)
+	int usedFrames __attribute__((aligned(CacheLineSize)));
+	unsigned int clockHand __attribute__((aligned(CacheLineSize)));
+	long long nextChunk __attribute__((aligned(CacheLineSize)));
+
+	int backingStore;							// Backing Store copy (pread/pwrite)
+} AddressSpace;
+
+// Worker - Private TLB and statistics of one translating thread
+typedef struct worker {
+	int TLBPageNumber[TLBEntriesAmount];
+	int TLBFrameNumber[TLBEntriesAmount];
+	int TLBNext;
+	Statistics statistics;
+	int id;
+} __attribute__((aligned(CacheLineSize))) Worker;
+
+/**
+ * 	Program Global Variables
+ */
+Trace *_trace;
+int *_physicalAddress, *_value;		// Results, written by the threads at the index of their reference
+AddressSpace *_space;
+Worker _workers[MaxThreads];
+int _workersAmount;
+
+/**
+ * 	Backing Store methods
+ */
+// Copying the Backing Store so write backs never touch the original file
+int copyBackingStore(const char *originalfile, const char *copyfile)
+{
+	int original = open(originalfile, O_RDONLY);
+	if (original == -1)
+		return -1;
+	int copy = open(copyfile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	char buffer[4096];
+	ssize_t bytes;
+
+	while (copy != -1 && (bytes = read(original, buffer, sizeof(buffer))) > 0)
+		if (write(copy, buffer, bytes) != bytes)
+			break;
+	close(original);
+	return copy;
+}
+
+// Loading a page on a frame being replaced (readers only see it once published)
+void getBackingStorePage(int pageNumber, int frameNumber)
+{
+	char page[FrameBytesSize];
+	if (pread(_space->backingStore, page, FrameBytesSize, (off_t)pageNumber*FrameBytesSize) != FrameBytesSize) {
+		fprintf(stderr, "Could not read page %d from the Backing Store\n", pageNumber);
+		exit(1);
+	}
+	for (int i = 0; i < FrameBytesSize; i++)
+		__atomic_store_n(&_space->frame[frameNumber][i], page[i], __ATOMIC_RELAXED);
+}
+
+// Writing a frame back on the Backing Store (no writer runs on it meanwhile)
+void writeBackFrame(int pageNumber, int frameNumber)
+{
+	char page[FrameBytesSize];
+	for (int i = 0; i < FrameBytesSize; i++)
+		page[i] = __atomic_load_n(&_space->frame[frameNumber][i], __ATOMIC_RELAXED);
+	if (pwrite(_space->backingStore, page, FrameBytesSize, (off_t)pageNumber*FrameBytesSize) != FrameBytesSize)
+		fprintf(stderr, "Could not write back page %d\n", pageNumber);
+}
+
+/**
+ * 	Frame methods
+ */
+// Reading a byte of the frame holding pageNumber. Fails (0) when the frame
+// is being replaced or was given to another page meanwhile
+int readFrame(int frameNumber, int pageNumber, int offset, int *value)
+{
+	unsigned int sequence = __atomic_load_n(&_space->sequence[frameNumber], __ATOMIC_ACQUIRE);
+	if ((sequence & 1) || __atomic_load_n(&_space->framePage[frameNumber], __ATOMIC_RELAXED) != pageNumber)
+		return 0;
+	*value = __atomic_load_n(&_space->frame[frameNumber][offset], __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&_space->sequence[frameNumber], __ATOMIC_RELAXED) == sequence;
+}
+
+// Starting the replacement of a frame (sequence becomes odd)
+void beginFrameUpdate(int frameNumber)
+{
+	__atomic_fetch_add(&_space->sequence[frameNumber], 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+// Ending the replacement of a frame (sequence becomes even)
+void endFrameUpdate(int frameNumber)
+{
+	__atomic_fetch_add(&_space->sequence[frameNumber], 1, __ATOMIC_RELEASE);
+}
+
+// Evicting the page of a frame (the caller holds the shard of the page)
+void evictFrame(Worker *worker, int frameNumber, int pageNumber)
+{
+	beginFrameUpdate(frameNumber);
+	unsigned int entry = __atomic_exchange_n(&_space->entry[pageNumber], 0, __ATOMIC_ACQ_REL);
+	if (entry & EntryDirty) {
+		writeBackFrame(pageNumber, frameNumber);
+		worker->statistics.DirtyEvictionsCounter++;
+		worker->statistics.BackingStoreWritesCounter++;
+	}
+	__atomic_store_n(&_space->framePage[frameNumber], -1, __ATOMIC_RELAXED);
+	worker->statistics.EvictionsCounter++;
+}
+
+// Taking a frame: a free one, or else the next unreferenced page of the CLOCK
+// hand whose shard is not locked by another thread (lockedShard is the
+// caller's). The frame comes out of every mapping, being replaced. Blocking
+// on a shard could deadlock two faulting threads, so a hand that keeps
+// finding every candidate locked backs off instead
+int takeFrame(Worker *worker, int lockedShard)
+{
+	if (__atomic_load_n(&_space->usedFrames, __ATOMIC_RELAXED) < FramesAmount) {
+		int frameNumber = __atomic_fetch_add(&_space->usedFrames, 1, __ATOMIC_RELAXED);
+		if (frameNumber < FramesAmount) {
+			beginFrameUpdate(frameNumber);
+			return frameNumber;
+		}
+	}
+
+	long backoff = BackoffMinNanoseconds;
+	for (int steps = 1; ; steps++) {
+		if (steps % (2*FramesAmount) == 0) {
+			struct timespec wait = {0, backoff};
+			nanosleep(&wait, NULL);
+			if (backoff < BackoffMaxNanoseconds)
+				backoff *= 2;
+		}
+
+		int frameNumber = __atomic_fetch_add(&_space->clockHand, 1, __ATOMIC_RELAXED) % FramesAmount;
+		int pageNumber = __atomic_load_n(&_space->framePage[frameNumber], __ATOMIC_RELAXED);
+		if (pageNumber == -1)
+			continue;
+
+		// Second chance
+		unsigned int entry = __atomic_load_n(&_space->entry[pageNumber], __ATOMIC_RELAXED);
+		if (entry & EntryReferenced) {
+			__atomic_fetch_and(&_space->entry[pageNumber], ~EntryReferenced, __ATOMIC_RELAXED);
+			continue;
+		}
+
+		int shard = pageNumber % PageTableShards;
+		if (shard != lockedShard && pthread_mutex_trylock(&_space->shard[shard].mutex) != 0)
+			continue;
+
+		// Still the same unreferenced mapping, now that nobody else can change it
+		entry = __atomic_load_n(&_space->entry[pageNumber], __ATOMIC_RELAXED);
+		int victim = __atomic_load_n(&_space->framePage[frameNumber], __ATOMIC_RELAXED) == pageNumber
+			&& (entry & (EntryValid | EntryReferenced)) == EntryValid
+			&& (int)(entry & EntryFrameMask) == frameNumber;
+		if (victim)
+			evictFrame(worker, frameNumber, pageNumber);
+
+		if (shard != lockedShard)
+			pthread_mutex_unlock(&_space->shard[shard].mutex);
+		if (victim)
+			return frameNumber;
+	}
+}
+
+/**
+ * 	Managing Page Table methods
+ */
+// Frame of a resident page, loading it on a page fault (the caller holds the
+// shard of the page)
+int mapPage(Worker *worker, int pageNumber, int shard)
+{
+	unsigned int entry = __atomic_load_n(&_space->entry[pageNumber], __ATOMIC_ACQUIRE);
+	if (entry & EntryValid)
+		return entry & EntryFrameMask;
+
+	int frameNumber = takeFrame(worker, shard);
+	getBackingStorePage(pageNumber, frameNumber);
+	worker->statistics.PageFaultsCounter++;
+
+	__atomic_store_n(&_space->framePage[frameNumber], pageNumber, __ATOMIC_RELAXED);
+	endFrameUpdate(frameNumber);
+	__atomic_store_n(&_space->entry[pageNumber], EntryValid | EntryReferenced | frameNumber, __ATOMIC_RELEASE);
+	return frameNumber;
+}
+
+/**
+ * 	Managing TLB methods
+ */
+// Finding Requested Page on the TLB of the thread (-1 when not found)
+int findPageOnTLB(Worker *worker, int pageNumber)
+{
+	for (int i = 0; i < TLBEntriesAmount; i++)
+		if (worker->TLBPageNumber[i] == pageNumber)
+			return i;
+	return -1;
+}
+
+// Setting Used Page on the TLB of the thread (FIFO)
+void setPageOnTLB(Worker *worker, int pageNumber, int frameNumber)
+{
+	worker->TLBPageNumber[worker->TLBNext] = pageNumber;
+	worker->TLBFrameNumber[worker->TLBNext] = frameNumber;
+	worker->TLBNext = (worker->TLBNext + 1) % TLBEntriesAmount;
+}
+
+/**
+ * 	Translation methods
+ */
+// Writing a byte under the shard of the page (value receives the byte stored)
+int translateWrite(Worker *worker, int pageNumber, int offset, int access, int writeValue, int *value)
+{
+	int shard = pageNumber % PageTableShards;
+	pthread_mutex_lock(&_space->shard[shard].mutex);
+	int frameNumber = mapPage(worker, pageNumber, shard);
+
+	char *byte = &_space->frame[frameNumber][offset];
+	*value = access == WriteAccess ? (char)writeValue : __atomic_load_n(byte, __ATOMIC_RELAXED);
+	__atomic_store_n(byte, (char)*value, __ATOMIC_RELAXED);
+	__atomic_fetch_or(&_space->entry[pageNumber], EntryDirty | EntryReferenced, __ATOMIC_RELAXED);
+	worker->statistics.WritesCounter++;
+
+	pthread_mutex_unlock(&_space->shard[shard].mutex);
+	setPageOnTLB(worker, pageNumber, frameNumber);
+	return frameNumber;
+}
+
+// Translating one reference: TLB, lock free Page Table walk, then the page
+// fault under the shard lock (returns the physical address)
+int translate(Worker *worker, int virtualAddress, int access, int writeValue, int *value)
+{
+	int pageNumber = (virtualAddress/PagesAmount) & (PagesAmount-1);
+	int offset = virtualAddress & (FrameBytesSize-1);
+	int frameNumber;
+
+	if (access != ReadAccess)
+		frameNumber = translateWrite(worker, pageNumber, offset, access, writeValue, value);
+	else for (;;) {
+		// TLB (entries whose frame was replaced by another thread are dropped)
+		int slot = findPageOnTLB(worker, pageNumber);
+		if (slot != -1) {
+			frameNumber = worker->TLBFrameNumber[slot];
+			if (readFrame(frameNumber, pageNumber, offset, value)) {
+				worker->statistics.TLBHitsCounter++;
+				break;
+			}
+			worker->TLBPageNumber[slot] = -1;
+		}
+
+		// Page Table
+		unsigned int entry = __atomic_load_n(&_space->entry[pageNumber], __ATOMIC_ACQUIRE);
+		if (entry & EntryValid) {
+			frameNumber = entry & EntryFrameMask;
+			if (!readFrame(frameNumber, pageNumber, offset, value))
+				continue;
+			if (!(entry & EntryReferenced))
+				__atomic_fetch_or(&_space->entry[pageNumber], EntryReferenced, __ATOMIC_RELAXED);
+			setPageOnTLB(worker, pageNumber, frameNumber);
+			break;
+		}
+
+		// Page Fault (the page can't be evicted while its shard is locked)
+		int shard = pageNumber % PageTableShards;
+		pthread_mutex_lock(&_space->shard[shard].mutex);
+		frameNumber = mapPage(worker, pageNumber, shard);
+		*value = __atomic_load_n(&_space->frame[frameNumber][offset], __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&_space->shard[shard].mutex);
+		setPageOnTLB(worker, pageNumber, frameNumber);
+		break;
+	}
+
+	worker->statistics.TranslatedAddressesCounter++;
+	return frameNumber*PagesAmount + offset;
+}
+
+/**
+ * 	Threads
+ */
+// Translating chunks of the trace until it ends
+void *thread_translate(void *arg)
+{
+	Worker *worker = (Worker*)arg;
+
+	for (;;) {
+		long long start = __atomic_fetch_add(&_space->nextChunk, ChunkReferences, __ATOMIC_RELAXED);
+		if (start >= _trace->length)
+			return NULL;
+		long long end = start + ChunkReferences < _trace->length ? start + ChunkReferences : _trace->length;
+
+		for (long long i = start; i < end; i++)
+			_physicalAddress[i] = translate(worker, _trace->virtualAddress[i],
+				_trace->access[i], _trace->writeValue[i], &_value[i]);
+	}
+}
+
+/**
+ * 	Initialization/Finalization methods
+ */
+// Creating the shared address space over a copy of the Backing Store
+void initialize()
+{
+	_space = (AddressSpace*)calloc(1, sizeof(AddressSpace));
+	_space->backingStore = copyBackingStore(backingStore_default, backingStoreCopy_default);
+	if (_space->backingStore == -1) {
+		fprintf(stderr, "Could not copy %s to %s\n", backingStore_default, backingStoreCopy_default);
+		exit(1);
+	}
+	struct stat status;
+	if (fstat(_space->backingStore, &status) != 0 || status.st_size < (off_t)PagesAmount*FrameBytesSize) {
+		fprintf(stderr, "%s holds less than %d pages\n", backingStore_default, PagesAmount);
+		exit(1);
+	}
+	for (int i = 0; i < PageTableShards; i++)
+		pthread_mutex_init(&_space->shard[i].mutex, NULL);
+	for (int i = 0; i < FramesAmount; i++)
+		_space->framePage[i] = -1;
+
+	for (int i = 0; i < _workersAmount; i++) {
+		memset(&_workers[i], 0, sizeof(Worker));
+		for (int j = 0; j < TLBEntriesAmount; j++)
+			_workers[i].TLBPageNumber[j] = _workers[i].TLBFrameNumber[j] = -1;
+		_workers[i].id = i;
+	}
+}
+
+// Writing back every dirty resident page and releasing the address space
+void finalize()
+{
+	for (int i = 0; i < PagesAmount; i++)
+		if ((_space->entry[i] & (EntryValid | EntryDirty)) == (EntryValid | EntryDirty)) {
+			writeBackFrame(i, _space->entry[i] & EntryFrameMask);
+			_workers[0].statistics.BackingStoreWritesCounter++;
+		}
+
+	for (int i = 0; i < PageTableShards; i++)
+		pthread_mutex_destroy(&_space->shard[i].mutex);
+	close(_space->backingStore);
+	free(_space);
+}
+
+/**
+ * 	Output results methods
+ */
+// Results in trace order, then the statistics of every thread added up
+void resultLog(char *resultfile)
+{
+	FILE *result = fopen(resultfile, "w");
+	Statistics total;
+	memset(&total, 0, sizeof(total));
+
+	for (long long i = 0; i < _trace->length; i++) {
+		fprintf(result, "Virtual address: %d ", _trace->virtualAddress[i]);
+		fprintf(result, "Physical address: %d ", _physicalAddress[i]);
+		fprintf(result, "Value: %d\n", _value[i]);
+	}
+
+	for (int i = 0; i < _workersAmount; i++) {
+		Statistics *statistics = &_workers[i].statistics;
+		total.TranslatedAddressesCounter += statistics->TranslatedAddressesCounter;
+		total.PageFaultsCounter += statistics->PageFaultsCounter;
+		total.TLBHitsCounter += statistics->TLBHitsCounter;
+		total.WritesCounter += statistics->WritesCounter;
+		total.DirtyEvictionsCounter += statistics->DirtyEvictionsCounter;
+		total.BackingStoreWritesCounter += statistics->BackingStoreWritesCounter;
+		total.EvictionsCounter += statistics->EvictionsCounter;
+	}
+
+	float pageFaultRate = total.PageFaultsCounter;
+		  pageFaultRate = pageFaultRate/total.TranslatedAddressesCounter;
+	float tlbHitsRate = total.TLBHitsCounter;
+		  tlbHitsRate = tlbHitsRate/total.TranslatedAddressesCounter;
+	fprintf(result, "Number of Translated Addresses = %lld\n", total.TranslatedAddressesCounter);
+	fprintf(result, "Page Faults = %lld\n", total.PageFaultsCounter);
+	fprintf(result, "Page Fault Rate = %.3f\n", pageFaultRate);
+	fprintf(result, "TLB Hits = %lld\n", total.TLBHitsCounter);
+	fprintf(result, "TLB Hit Rate = %.3f\n", tlbHitsRate);
+	if (total.WritesCounter > 0) {
+		fprintf(result, "Writes = %lld\n", total.WritesCounter);
+		fprintf(result, "Dirty Evictions = %lld\n", total.DirtyEvictionsCounter);
+		fprintf(result, "Backing Store Writes = %lld\n", total.BackingStoreWritesCounter);
+	}
+	fprintf(result, "Evictions = %lld\n", total.EvictionsCounter);
+	fprintf(result, "Threads = %d\n", _workersAmount);
+	fclose(result);
+}
+
+/**
+ * 	Main Concurrent Memory Manager
+ *
+ *	MemoryManager_Concurrent [-t threads] [addresses]
+ */
+int main(int arc, char** argv)
+{
+	char *inputfile = inputfile_default;
+	_workersAmount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	for (int i = 1; i < arc; i++) {
+		if (strcmp(argv[i], "-t") == 0 && i + 1 < arc)
+			_workersAmount = atoi(argv[++i]);
+		else
+			inputfile = argv[i];
+	}
+	if (_workersAmount < 1)				_workersAmount = 1;
+	if (_workersAmount > MaxThreads)	_workersAmount = MaxThreads;
+
+	_trace = loadTrace(inputfile, 1);
+	if (_trace->length == 0) {
+		fprintf(stderr, "Empty trace\n");
+		return 1;
+	}
+	_physicalAddress = (int*)malloc(_trace->length*sizeof(int));
+	_value = (int*)malloc(_trace->length*sizeof(int));
+	initialize();
+
+	// Only the translation is timed
+	pthread_t threads[MaxThreads];
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < _workersAmount; i++)
+		pthread_create(&threads[i], NULL, thread_translate, &_workers[i]);
+	for (int i = 0; i < _workersAmount; i++)
+		pthread_join(threads[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec)*1e-9;
+	printf("%d thread(s): %lld references in %.3f s (%.0f references/s)\n",
+		_workersAmount, _trace->length, seconds, _trace->length/seconds);
+
+	finalize();
+	resultLog(result_default);
+
+	free(_physicalAddress);
+	free(_value);
+	freeTrace(_trace);
+	return 0;
+}
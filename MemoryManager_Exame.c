@@ -18,7 +18,7 @@
  * 	Memory Manager Defines
  */
 // Max Number Definitions
-#define MaxStringLength			7
+#define MaxStringLength			16
 
 // Virtual Memory Pages
 #define PagesAmount				256
@@ -35,11 +35,39 @@
 
 //Segmentation
 #define SegmentsAmount			4
+#define MemoryFramesAmount		(SegmentsAmount*FramesAmount)
+#define SegmentFromAddress		0		// 1: segment number taken from the address bits
+
+// Frame Allocation Policies
+#define FixedAllocation			0		// FramesAmount frames reserved per segment
+#define WorkingSetAllocation	1		// Denning's working set over the window
+#define PFFAllocation			2		// Page fault frequency controller
+#define AllocationPolicy		FixedAllocation
+
+// Dynamic Allocation (lower PoolFramesAmount to overcommit memory)
+#define PoolFramesAmount		MemoryFramesAmount
+#define WindowLength			64		// Last references of each segment
+#define PFFUpperRate			0.50	// Grow budget above this fault rate
+#define PFFLowerRate			0.10	// Shrink budget below this fault rate
+#define IntervalLength			100		// References per interval statistics
+
+// Page Deduplication (KSM): pages loaded with identical contents share one frame.
+// Translation only reads, so shared frames are never written and need no copy on
+// write (frames come from a single pool, fixed allocation keeps FramesAmount pages
+// per segment)
+#define PageDeduplication		0
+#define DedupBuckets			256		// Content hash buckets
+#define HashLanes				8		// 32-bit lanes hashed in parallel
+
+#if PoolFramesAmount > MemoryFramesAmount
+#error "PoolFramesAmount cannot exceed the physical memory frames"
+#endif
 
 //Files
 #define inputfile_default 		"addresses.txt"
 #define backingStore_default 	"BACKING_STORE.bin"
 #define result_default 			"result.txt"
+#define intervals_default 		"intervals.txt"
 
 	/**
 	*     Memory Manager Structs
@@ -48,7 +76,10 @@
 // Page Table (256 pages)
 typedef struct pageTable {
 	int frameNumber[PagesAmount];
-	unsigned int FIFO[FramesAmount];
+	// FIFO of resident pages (linked by page number, oldest first)
+	int FIFOPrev[PagesAmount], FIFONext[PagesAmount];
+	int FIFOHead, FIFOTail;
+	int residentPages;
 } PageTable;
 
 // Segmentation (4 segmentations)
@@ -71,26 +102,65 @@ typedef struct tlb {
 
 // Physical Memory (65.536 bytes)
 typedef struct memory {
-	Page frame[SegmentsAmount*FramesAmount];
-	int available[SegmentsAmount*FramesAmount];
+	Page frame[MemoryFramesAmount];
+	// Stacks of available frames: one per segment range (fixed allocation)
+	// starting at segment*FramesAmount, or a single one for the pool
+	int freeFrames[MemoryFramesAmount];
+	int freeFramesCount[SegmentsAmount];
 	int availableSegmentation[SegmentsAmount];
+	// Deduplication: pages sharing each frame and its content hash, chained by bucket
+	int sharers[MemoryFramesAmount];
+	unsigned int contentHash[MemoryFramesAmount];
+	int hashNext[MemoryFramesAmount];
+	int hashBuckets[DedupBuckets];
+	// Hash of every Backing Store page, computed on its first load (the Backing
+	// Store is only read, so a reloaded page is not hashed again)
+	unsigned int pageHash[PagesAmount];
+	char pageHashed[PagesAmount];
 } Memory;
 
+// Hash Lanes - One vector of 32-bit lanes (SIMD where the target has it)
+typedef unsigned int HashLanesVector __attribute__((vector_size(HashLanes*sizeof(unsigned int))));
+
+// Frame Allocation - Dynamic frame budget of each segment
+typedef struct allocation {
+	int budget;
+
+	// Sliding window of the segment references, updated incrementally
+	int window[WindowLength];
+	int windowCount[PagesAmount];
+	int workingSetSize;
+	char faultWindow[WindowLength];
+	int faultsInWindow;
+	int virtualTime;
+
+	// Current interval
+	int intervalReferences;
+	int intervalFaults;
+} Allocation;
+
 // Statistics
 typedef struct statistics {
 	int TranslatedAddressesCounter;
 	int SegmentationFaultsCounter;
 	int PageFaultsCounter;
 	int TLBHitsCounter;
+	int FramesReleasedCounter;
+	int FramesReclaimedCounter;
+	int OvercommittedIntervalsCounter;
+	int MergedPagesCounter;
+	int FramesSavedCounter;			// Frames currently saved by sharing
+	int PeakFramesSavedCounter;
 } Statistics;
 
 /**
 *     Program Global Variables
 */
-FILE *addresses, *result, *backingStore;
+FILE *addresses, *result, *backingStore, *intervals;
 char line[MaxStringLength] = "";
 
 Segmentation *_descriptorTable;
+Allocation *_allocation;
 Statistics *_statistics;
 Memory *_memory;
 TLB *_TLB;
@@ -124,6 +194,66 @@ void statisticsLog()
 	fprintf(result, "Page Fault Rate = %.3f\n", pageFaultRate);
 	fprintf(result, "TLB Hits = %d\n", _statistics->TLBHitsCounter);
 	fprintf(result, "TLB Hit Rate = %.3f\n", tlbHitsRate);
+
+	if (AllocationPolicy != FixedAllocation) {
+		fprintf(result, "Frames Released = %d\n", _statistics->FramesReleasedCounter);
+		fprintf(result, "Frames Reclaimed = %d\n", _statistics->FramesReclaimedCounter);
+		fprintf(result, "Overcommitted Intervals = %d\n", _statistics->OvercommittedIntervalsCounter);
+	}
+
+	if (PageDeduplication) {
+		fprintf(result, "Merged Pages = %d\n", _statistics->MergedPagesCounter);
+		fprintf(result, "Frames Saved = %d\n", _statistics->FramesSavedCounter);
+		fprintf(result, "Peak Frames Saved = %d\n", _statistics->PeakFramesSavedCounter);
+	}
+}
+
+// Interval Statistics Log (one line per segment)
+void intervalLog()
+{
+	int interval = (_statistics->TranslatedAddressesCounter - 1) / IntervalLength;
+	int references = 0, faults = 0, budget = 0, workingSet = 0, resident = 0;
+
+	for (int i = 0; i < SegmentsAmount; i++) {
+		Allocation *allocation = &_allocation[i];
+		int residentPages = _descriptorTable[i].pageTable->residentPages;
+
+		fprintf(intervals, "%8d %7d %10d %6d %6d %10d %8d\n", interval, i,
+			allocation->intervalReferences, allocation->intervalFaults,
+			allocation->budget, allocation->workingSetSize, residentPages);
+
+		references += allocation->intervalReferences;
+		faults += allocation->intervalFaults;
+		budget += allocation->budget;
+		workingSet += allocation->workingSetSize;
+		resident += residentPages;
+		allocation->intervalReferences = allocation->intervalFaults = 0;
+	}
+	fprintf(intervals, "%8d %7s %10d %6d %6d %10d %8d\n", interval, "all",
+		references, faults, budget, workingSet, resident);
+
+	// Budgets demand more frames than the pool holds
+	if (budget > PoolFramesAmount)
+		_statistics->OvercommittedIntervalsCounter++;
+}
+
+/**
+*     Free Frames methods
+*/
+// Returning a frame to the stack of its range
+void pushFreeFrame(int frameNumber)
+{
+	int range = AllocationPolicy == FixedAllocation && !PageDeduplication ? frameNumber/FramesAmount : 0;
+	_memory->freeFrames[range*FramesAmount + _memory->freeFramesCount[range]++] = frameNumber;
+}
+
+// Taking a frame from the stack of the segment range (-1 when it is empty)
+int popFreeFrame(int segmentNumber)
+{
+	int range = AllocationPolicy == FixedAllocation && !PageDeduplication ? segmentNumber : 0;
+	if (_memory->freeFramesCount[range] == 0)
+		return -1;
+	return _memory->freeFrames[range*FramesAmount + --_memory->freeFramesCount[range]];
 }
 
 /**
@@ -135,17 +265,29 @@ void initialize(char * inputfile)
 	backingStore = fopen(backingStore_default, "r");
 	addresses = fopen(inputfile, "r");
 	result = fopen(result_default, "w");
+	if (AllocationPolicy != FixedAllocation)
+		intervals = fopen(intervals_default, "w");
 
 	_statistics = (Statistics*)malloc(sizeof(Statistics));
 	_memory = (Memory*)malloc(sizeof(Memory));
 	_TLB = (TLB*)malloc(sizeof(TLB));
 	_descriptorTable = (Segmentation*)malloc(SegmentsAmount * sizeof(Segmentation));
+	_allocation = (Allocation*)calloc(SegmentsAmount, sizeof(Allocation));
 
 	for (int j = 0; j < SegmentsAmount; j ++) {
 		for (int i = 0; i < PagesAmount; i++) {
 			_descriptorTable[j].pageTable->frameNumber[i] = -1;
-			_descriptorTable[j].pageTable->FIFO[i] = -1;
+			_descriptorTable[j].pageTable->FIFOPrev[i] = -1;
+			_descriptorTable[j].pageTable->FIFONext[i] = -1;
 		}
+		_descriptorTable[j].pageTable->FIFOHead = -1;
+		_descriptorTable[j].pageTable->FIFOTail = -1;
+		_descriptorTable[j].pageTable->residentPages = 0;
+	}
+
+	for (int i = 0; i < SegmentsAmount; i++) {
+		if (AllocationPolicy == FixedAllocation)	_allocation[i].budget = FramesAmount;
+		if (AllocationPolicy == PFFAllocation)		_allocation[i].budget = PoolFramesAmount/SegmentsAmount;
 	}
 
 	for (int i = 0; i < TLBEntriesAmount; i++)
@@ -153,25 +295,52 @@ void initialize(char * inputfile)
 
 	for (int i = 0; i < SegmentsAmount; i++)
 		_memory->availableSegmentation[i] = -1;
-	
-	for (int i = 0; i < SegmentsAmount*FramesAmount; i++)
-		_memory->available[i] = 1;
+
+	for (int i = 0; i < MemoryFramesAmount; i++)
+		_memory->sharers[i] = 0;
+	for (int i = 0; i < DedupBuckets; i++)
+		_memory->hashBuckets[i] = -1;
+	for (int i = 0; i < PagesAmount; i++)
+		_memory->pageHashed[i] = 0;
+
+	// Pushed downwards, so frames are first handed out in increasing order
+	for (int i = 0; i < SegmentsAmount; i++)
+		_memory->freeFramesCount[i] = 0;
+	for (int i = (AllocationPolicy == FixedAllocation ? MemoryFramesAmount : PoolFramesAmount) - 1; i >= 0; i--)
+		pushFreeFrame(i);
 
 	_statistics->TranslatedAddressesCounter = 0;
 	_statistics->SegmentationFaultsCounter = 0;
 	_statistics->PageFaultsCounter = 0;
 	_statistics->TLBHitsCounter = 0;
+	_statistics->FramesReleasedCounter = 0;
+	_statistics->FramesReclaimedCounter = 0;
+	_statistics->OvercommittedIntervalsCounter = 0;
+	_statistics->MergedPagesCounter = 0;
+	_statistics->FramesSavedCounter = 0;
+	_statistics->PeakFramesSavedCounter = 0;
+
+	if (AllocationPolicy != FixedAllocation)
+		fprintf(intervals, "%8s %7s %10s %6s %6s %10s %8s\n", "Interval", "Segment",
+			"References", "Faults", "Budget", "WorkingSet", "Resident");
 }
 
 // Finalizing the Memory Manager
 void finalize()
 {
+	// Last partial interval
+	if (AllocationPolicy != FixedAllocation && _statistics->TranslatedAddressesCounter % IntervalLength != 0)
+		intervalLog();
+
 	statisticsLog();
 	fclose(backingStore);
 	fclose(addresses);
 	fclose(result);
+	if (AllocationPolicy != FixedAllocation)
+		fclose(intervals);
 
 	free(_descriptorTable);
+	free(_allocation);
 	free(_memory);
 	free(_TLB);
 }
@@ -259,56 +428,218 @@ void setPageOnTLB(int segmentNumber, int pageNumber, int frameNumber)
 	_TLB->pageNumber[newTLBindex] = pageNumber;
 }
 
+// Invalidating an evicted Page on TLB
+void invalidatePageOnTLB(int segmentNumber, int pageNumber)
+{
+	for (int i = 0; i < TLBEntriesAmount; i++)
+		if (_TLB->segmentNumber[i] == segmentNumber && _TLB->pageNumber[i] == pageNumber)
+			_TLB->segmentNumber[i] = _TLB->frameNumber[i] = _TLB->pageNumber[i] = -1;
+}
+
+/**
+*     Page Deduplication methods
+*/
+
+// Hashing a page content: xxHash32-style rounds on HashLanes independent
+// lanes, so one vector instruction advances every lane at once
+unsigned int hashPageContent(const char *content)
+{
+	HashLanesVector lanes, words;
+	for (int i = 0; i < HashLanes; i++)
+		lanes[i] = 0x9E3779B1u*(i + 1);
+
+	for (int i = 0; i < FrameBytesSize; i += sizeof(HashLanesVector)) {
+		memcpy(&words, content + i, sizeof(HashLanesVector));
+		lanes += words*0x85EBCA77u;
+		lanes = (lanes << 13 | lanes >> 19)*0x9E3779B1u;
+	}
+
+	unsigned int hash = FrameBytesSize;
+	for (int i = 0; i < HashLanes; i++)
+		hash = (hash ^ lanes[i])*0x85EBCA77u;
+	return hash ^ hash >> 15;
+}
+
+// Merging a frame just loaded with pageNumber with an identical one, returning
+// the frame the page uses (a merged frame goes back to the free frames)
+int mergeFrameOnMemory(int pageNumber, int frameNumber)
+{
+	if (!_memory->pageHashed[pageNumber]) {
+		_memory->pageHash[pageNumber] = hashPageContent(_memory->frame[frameNumber].PageContent);
+		_memory->pageHashed[pageNumber] = 1;
+	}
+	unsigned int hash = _memory->pageHash[pageNumber];
+	int *bucket = &_memory->hashBuckets[hash % DedupBuckets];
+
+	for (int i = *bucket; i != -1; i = _memory->hashNext[i])
+		if (_memory->contentHash[i] == hash &&
+			memcmp(_memory->frame[i].PageContent, _memory->frame[frameNumber].PageContent, FrameBytesSize) == 0) {
+			_memory->sharers[i]++;
+			pushFreeFrame(frameNumber);
+			_statistics->MergedPagesCounter++;
+			if (++_statistics->FramesSavedCounter > _statistics->PeakFramesSavedCounter)
+				_statistics->PeakFramesSavedCounter = _statistics->FramesSavedCounter;
+			return i;
+		}
+
+	// First page with this content
+	_memory->sharers[frameNumber] = 1;
+	_memory->contentHash[frameNumber] = hash;
+	_memory->hashNext[frameNumber] = *bucket;
+	*bucket = frameNumber;
+	return frameNumber;
+}
+
+// Dropping one page of a frame, returning how many pages still share it
+int unshareFrameOnMemory(int frameNumber)
+{
+	if (--_memory->sharers[frameNumber] > 0) {
+		_statistics->FramesSavedCounter--;
+		return _memory->sharers[frameNumber];
+	}
+
+	// Last page: the frame leaves its bucket
+	int *link = &_memory->hashBuckets[_memory->contentHash[frameNumber] % DedupBuckets];
+	while (*link != frameNumber)
+		link = &_memory->hashNext[*link];
+	*link = _memory->hashNext[frameNumber];
+	return 0;
+}
+
 /**
 *     Managing Memory methods
 */
 
-// Find Oldest Frame on memory (first element on FIFO)
-int findOldestFrameOnMemory(int segmentNumber, int pageNumber)
+// Appending a loaded page to the segment FIFO
+void pushPageOnFIFO(int segmentNumber, int pageNumber)
 {
-	//The oldest page on the queue
-	int switchedpage = _descriptorTable[segmentNumber].pageTable->FIFO[0];
+	PageTable *pageTable = _descriptorTable[segmentNumber].pageTable;
+
+	pageTable->FIFOPrev[pageNumber] = pageTable->FIFOTail;
+	pageTable->FIFONext[pageNumber] = -1;
+	if (pageTable->FIFOTail != -1)
+		pageTable->FIFONext[pageTable->FIFOTail] = pageNumber;
+	else
+		pageTable->FIFOHead = pageNumber;
+	pageTable->FIFOTail = pageNumber;
+	pageTable->residentPages++;
+}
+
+// Removing a page from anywhere on the segment FIFO
+void removePageFromFIFO(int segmentNumber, int pageNumber)
+{
+	PageTable *pageTable = _descriptorTable[segmentNumber].pageTable;
+	int prev = pageTable->FIFOPrev[pageNumber];
+	int next = pageTable->FIFONext[pageNumber];
+
+	if (prev != -1)	pageTable->FIFONext[prev] = next;
+	else			pageTable->FIFOHead = next;
+	if (next != -1)	pageTable->FIFOPrev[next] = prev;
+	else			pageTable->FIFOTail = prev;
+
+	pageTable->FIFOPrev[pageNumber] = pageTable->FIFONext[pageNumber] = -1;
+	pageTable->residentPages--;
+}
+
+// Evicting a resident page, returning the frame it used (-1 while other
+// pages still share it)
+int evictPageOnMemory(int segmentNumber, int pageNumber)
+{
+	int slot = _descriptorTable[segmentNumber].pageTable->frameNumber[pageNumber];
 
 	//Sets the switched page as unavailable
-	int slot = _descriptorTable[segmentNumber].pageTable->frameNumber[switchedpage];
-	_descriptorTable[segmentNumber].pageTable->frameNumber[switchedpage] = -1;
+	_descriptorTable[segmentNumber].pageTable->frameNumber[pageNumber] = -1;
+	invalidatePageOnTLB(segmentNumber, pageNumber);
+	removePageFromFIFO(segmentNumber, pageNumber);
 
-	//Updates the
-	for (int i = 0; i < FramesAmount - 1; i++) {
-		_descriptorTable[segmentNumber].pageTable->FIFO[i] = _descriptorTable[segmentNumber].pageTable->FIFO[i + 1];
+	if (PageDeduplication && unshareFrameOnMemory(slot) > 0)
+		return -1;
+	return slot;
+}
+
+// Releasing a resident page frame back to the pool
+void releasePageOnMemory(int segmentNumber, int pageNumber)
+{
+	int slot = evictPageOnMemory(segmentNumber, pageNumber);
+	if (slot != -1) {
+		pushFreeFrame(slot);
+		_statistics->FramesReleasedCounter++;
 	}
+}
 
-	_descriptorTable[segmentNumber].pageTable->FIFO[FramesAmount - 1] = pageNumber;
-	return slot;
+// Evicting every page of a segment, returning its frames
+void evictSegmentOnMemory(int segmentNumber)
+{
+	while (_descriptorTable[segmentNumber].pageTable->FIFOHead != -1)
+		releasePageOnMemory(segmentNumber, _descriptorTable[segmentNumber].pageTable->FIFOHead);
 }
 
+// Find Oldest Frame on memory (first element on FIFO)
+int findOldestFrameOnMemory(int segmentNumber)
+{
+	//The oldest page on the queue
+	int switchedpage = _descriptorTable[segmentNumber].pageTable->FIFOHead;
+	return evictPageOnMemory(segmentNumber, switchedpage);
+}
 
-//Updates values of Page Table FIFO
-void updatePageTableFIFO(int segmentNumber, int pageNumber) {
+// Find Available Frame on memory (fixed allocation only takes the segment's
+// own frames); -1 when there is not available memory
+int findAvailableFrameOnMemory(int segmentNumber)
+{
+	return popFreeFrame(segmentNumber);
+}
 
-	for (int i = 0; i < FramesAmount - 1; i++) {
-		_descriptorTable[segmentNumber].pageTable->FIFO[i] = _descriptorTable[segmentNumber].pageTable->FIFO[i + 1];
+// Reclaim Frame from the segment with the most resident pages or, growing
+// within the budgets, the highest resident/budget ratio above the one the
+// segment reaches. Overcommitted budgets (more than the pool holds) then
+// shrink alike, as if scaled down to the pool
+int reclaimFrameOnMemory(int segmentNumber, int overBudgetOnly)
+{
+	int victimSegment = -1;
+	int victimResident = overBudgetOnly ? _descriptorTable[segmentNumber].pageTable->residentPages + 1 : 0;
+	int victimBudget = overBudgetOnly ? _allocation[segmentNumber].budget : 1;
+
+	for (int i = 0; i < SegmentsAmount; i++) {
+		int residentPages = _descriptorTable[i].pageTable->residentPages;
+		int budget = overBudgetOnly ? _allocation[i].budget : 1;
+		// residentPages/budget > victimResident/victimBudget
+		if (i != segmentNumber && residentPages > 0 && residentPages*victimBudget > victimResident*budget) {
+			victimSegment = i;
+			victimResident = residentPages;
+			victimBudget = budget;
+		}
 	}
 
-	//Puts the most recent page as the last of queue
-	_descriptorTable[segmentNumber].pageTable->FIFO[FramesAmount - 1] = pageNumber;
+	//There is no segment to take a frame from
+	if (victimSegment == -1)
+		return -1;
+
+	_statistics->FramesReclaimedCounter++;
+	return findOldestFrameOnMemory(victimSegment);
 }
 
-// Find Available Frame on memory
-int findAvailableFrameOnMemory(int segmentNumber, int pageNumber)
+// Find Frame on memory within the segment budget
+int findBudgetFrameOnMemory(int segmentNumber)
 {
-	int memIndex = segmentNumber*FramesAmount;
-	for (int i = memIndex; i < memIndex + FramesAmount; i++) {
-		if (_memory->available[i] == 1) {
-			_memory->available[i] = 0;
-			updatePageTableFIFO(segmentNumber, pageNumber);
-			//There is available memory
-			return i;
-		}
+	int chosenFrame = -1;
+	int residentPages = _descriptorTable[segmentNumber].pageTable->residentPages;
+
+	// Below budget: grow into a free frame or one taken from a segment fuller for its budget
+	if (residentPages < _allocation[segmentNumber].budget) {
+		chosenFrame = findAvailableFrameOnMemory(segmentNumber);
+		if (chosenFrame == -1)
+			chosenFrame = reclaimFrameOnMemory(segmentNumber, 1);
 	}
 
-	//There is not available memory
-	return -1;
+	// At budget: replace the segment's own oldest page
+	if (chosenFrame == -1 && residentPages > 0)
+		chosenFrame = findOldestFrameOnMemory(segmentNumber);
+
+	// Overcommitted pool and nothing of its own to replace
+	if (chosenFrame == -1)
+		chosenFrame = reclaimFrameOnMemory(segmentNumber, 0);
+
+	return chosenFrame;
 }
 
 // Find Segmentation Slot on Memory
@@ -329,9 +660,9 @@ int findSegmentationSlotOnMemory(int segmentNumber)
 	}
 	// Segmentation slot already used by ANOTHER segmentNumber
 	else {
-			// Overwrite previous Segmentation allocated on memory
-			//   NOT IMPLEMENTED IN THIS PROJECT
-			printf("DEATH");
+			// Overwrite previous Segmentation allocated on memory,
+			// giving its frames back
+			evictSegmentOnMemory(segmentationSlot);
 			// Segmentation Fault
 			_statistics->SegmentationFaultsCounter++;
 			_memory->availableSegmentation[segmentationSlot] = segmentNumber;
@@ -345,14 +676,88 @@ int findSegmentationSlotOnMemory(int segmentNumber)
 int findFrameOnMemory(int segmentNumber, int pageNumber)
 {
 	int segmentationSlot = findSegmentationSlotOnMemory(segmentNumber);
-	int chosenFrame = findAvailableFrameOnMemory(segmentationSlot, pageNumber);
+	int chosenFrame;
 
-	if (chosenFrame == -1) {
-		chosenFrame = findOldestFrameOnMemory(segmentationSlot, pageNumber);
+	if (AllocationPolicy == FixedAllocation && !PageDeduplication) {
+		chosenFrame = findAvailableFrameOnMemory(segmentationSlot);
+		if (chosenFrame == -1)
+			chosenFrame = findOldestFrameOnMemory(segmentationSlot);
 	}
+	// Evicting a page of a shared frame frees nothing: evict until a frame is free
+	else
+		do chosenFrame = findBudgetFrameOnMemory(segmentationSlot);
+		while (chosenFrame == -1);
+
+	//Puts the most recent page as the last of queue
+	pushPageOnFIFO(segmentationSlot, pageNumber);
 	return chosenFrame;
 }
 
+/**
+*     Frame Allocation methods
+*/
+
+// Sliding the segment window over a new reference (before translating it)
+void updateAllocationWindow(int segmentNumber, int pageNumber)
+{
+	Allocation *allocation = &_allocation[segmentNumber];
+	int slot = allocation->virtualTime % WindowLength;
+	int outgoingPage = allocation->window[slot];
+
+	// The new reference enters the window
+	allocation->window[slot] = pageNumber;
+	if (allocation->windowCount[pageNumber]++ == 0)
+		allocation->workingSetSize++;
+
+	// The oldest reference leaves it once the window is full
+	if (allocation->virtualTime >= WindowLength) {
+		allocation->faultsInWindow -= allocation->faultWindow[slot];
+		if (--allocation->windowCount[outgoingPage] == 0) {
+			allocation->workingSetSize--;
+
+			// Pages out of the working set give their frames back
+			if (AllocationPolicy == WorkingSetAllocation &&
+				findPageOnPageTable(segmentNumber, outgoingPage) != -1)
+				releasePageOnMemory(segmentNumber, outgoingPage);
+		}
+	}
+	allocation->faultWindow[slot] = 0;
+	allocation->virtualTime++;
+	allocation->intervalReferences++;
+
+	if (AllocationPolicy == WorkingSetAllocation)
+		allocation->budget = allocation->workingSetSize;
+}
+
+// Adjusting the PFF budget on a page fault (before loading the page)
+void updatePFFBudget(int segmentNumber)
+{
+	Allocation *allocation = &_allocation[segmentNumber];
+	int windowLength = allocation->virtualTime < WindowLength ? allocation->virtualTime : WindowLength;
+	float faultRate = allocation->faultsInWindow;
+		  faultRate = faultRate / windowLength;
+
+	// Faulting too often: give the segment one more frame
+	if (faultRate > PFFUpperRate && allocation->budget < PagesAmount)
+		allocation->budget++;
+
+	// Faulting rarely: shrink the budget and give back the oldest pages
+	else if (faultRate < PFFLowerRate && allocation->budget > 1) {
+		allocation->budget--;
+		while (_descriptorTable[segmentNumber].pageTable->residentPages > allocation->budget)
+			releasePageOnMemory(segmentNumber, _descriptorTable[segmentNumber].pageTable->FIFOHead);
+	}
+}
+
+// Recording a page fault on the segment window
+void recordPageFault(int segmentNumber)
+{
+	Allocation *allocation = &_allocation[segmentNumber];
+	allocation->faultWindow[(allocation->virtualTime - 1) % WindowLength] = 1;
+	allocation->faultsInWindow++;
+	allocation->intervalFaults++;
+}
+
 /**
 *  Managing Backing Store methods
 */
@@ -401,6 +806,9 @@ void debugFrameAddress(int address, int segmentNumber, int frameNumber, int offs
 */
 int findFrameNumber(int segmentNumber, int pageNumber)
 {
+	// Slide the segment allocation window
+	updateAllocationWindow(segmentNumber, pageNumber);
+
 	// Find frameNumber on TLB
 	int frameNumber = findPageOnTLB(segmentNumber, pageNumber);
 
@@ -413,9 +821,15 @@ int findFrameNumber(int segmentNumber, int pageNumber)
 		// If Page Fault
 		if (frameNumber == -1)
 		{
+			if (AllocationPolicy == PFFAllocation)
+				updatePFFBudget(segmentNumber);
+			recordPageFault(segmentNumber);
+
 			// Load on memory entire page of BACKING_STORE
 			frameNumber = findFrameOnMemory(segmentNumber, pageNumber);
 			getBackingStorePage(segmentNumber, pageNumber, frameNumber);
+			if (PageDeduplication)
+				frameNumber = mergeFrameOnMemory(pageNumber, frameNumber);
 
 			// Set up accessed page on Page Table
 			setPageOnPageTable(segmentNumber, pageNumber, frameNumber);
@@ -443,17 +857,24 @@ int main(int arc, char** argv)
 		int offset = virtualAddress & (OffsetBits - 1);
 
 		// Segmentation Number consideration (only 4 segmentations)
-		segmentNumber = _statistics->TranslatedAddressesCounter % SegmentsAmount;
+		if (!SegmentFromAddress)
+			segmentNumber = _statistics->TranslatedAddressesCounter % SegmentsAmount;
 
 		// Find frameNumber
 		int frameNumber = findFrameNumber(segmentNumber, pageNumber);
 		
-		// Parse real Address
-		int frameIndex = frameNumber - segmentNumber*FramesAmount;
+		// Parse real Address (dynamic policies and deduplication share one frame pool)
+		int frameIndex = frameNumber;
+		if (AllocationPolicy == FixedAllocation && !PageDeduplication)
+			frameIndex = frameNumber - segmentNumber*FramesAmount;
 		int value = _memory->frame[frameNumber].PageContent[offset];
 		int realAddress = frameIndex*PagesAmount + offset;
 	  	writeOut(segmentNumber, virtualAddress, realAddress, value);
 
+		// Interval statistics (of the dynamic budgets)
+		if (AllocationPolicy != FixedAllocation && _statistics->TranslatedAddressesCounter % IntervalLength == 0)
+			intervalLog();
+
 		// Debugging PageAddress and FrameAddress
 		//debugPageAddress(virtualAddress, segmentNumber, pageNumber, offset);
 		//debugFrameAddress(realAddress, segmentNumber, frameNumber, offset);
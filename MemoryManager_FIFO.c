@@ -10,16 +10,52 @@
 /**
  * 	Memory Manager Includes
  */
+// Instrumentation (0: compiled out, no cost on the hot path)
+#ifndef Instrumentation
+#define Instrumentation		0
+#endif
+// Profiler (1: per-page heatmap and reuse distance histogram)
+#ifndef Profiler
+#define Profiler			0
+#endif
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L		// posix_memalign, clock_gettime
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "libmemmgr.h"
+// Compressed traces (set by the makefile when zlib or zstd are installed)
+#ifndef TraceGzip
+#define TraceGzip			0
+#endif
+#ifndef TraceZstd
+#define TraceZstd			0
+#endif
+#if TraceGzip
+#include <zlib.h>
+#endif
+#if TraceZstd
+#include <zstd.h>
+#endif
+#if Instrumentation
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
 
 /**
  * 	Memory Manager Defines
  */
 // Max Number Definitions
-#define MaxStringLength 	7
+#define MaxStringLength 	16		//Versao 3: "address [R|W [value]]"
 #define NumThreads			2		//Versao 2: implementacao de threads
 
 // Virtual Memory Pages
@@ -29,19 +65,208 @@
 // Physical Memory RAM
 #define FramesAmount 		256		//Versao 2: 128 quadros de paginas
 #define FrameBytesSize 		256
+#define VirtualAddressMask	(PagesAmount*FrameBytesSize - 1)	// 16 bit virtual addresses
+
+// Layout
+#define CacheLineSize		64
+#define FrameWords			((FramesAmount + 63)/64)	// Words of the availability bitset
+#define SummaryWords		((FrameWords + 63)/64)		// One bit per word with available frames
+
+// Page Table Entries: frame number plus valid/referenced/dirty bits in one word
+#define EntryValid			0x80000000u
+#define EntryReferenced		0x40000000u		// Set when a translation walks the entry
+#define EntryDirty			0x20000000u
+#define EntryFrameMask		0x00FFFFFFu
+
+// Dirty Pages
+#define WriteBackBatch		16		// Dirty victims coalesced per flush
+#ifndef PreferCleanVictims
+#define PreferCleanVictims	0		// 1: evict the oldest clean page first
+#endif
+#define CleanVictimWindow	8		// Oldest pages searched for a clean one
+
+// Prefetcher
+#define PrefetchNone		0
+#define PrefetchNextN		1		// The PrefetchDegree pages after a fault
+#define PrefetchStride		2		// PrefetchDegree pages along a repeated fault stride
+#define PrefetchReadahead	3		// Window doubling up to PrefetchMaxWindow
+#ifndef PrefetchPolicy
+#define PrefetchPolicy		PrefetchNone
+#endif
+#define PrefetchDegree		4
+#define PrefetchMaxWindow	32
+
+// Storage Model (Backing Store device driving the simulated clock, in nanoseconds)
+#define StorageNone			0		// Faults cost no time
+#define StorageHDD			1		// Seek over the page distance, half a rotation, transfer
+#define StorageSSD			2
+#define StorageNVMe			3		// NVMeQueueDepth requests in service at once
+#define StorageZRAM			4		// Compressed RAM swap: (de)compression stalls the CPU
+#ifndef StorageModel
+#define StorageModel		StorageNone		// -DStorageModel=StorageSSD (or another) turns timing on
+#endif
+#define TLBLatency			1
+#define MemoryLatency		100		// Page Table walk or data access
+#define HDDMinSeek			500000
+#define HDDMaxSeek			18000000
+#define HDDRotation			8333333		// 7200 rpm
+#define HDDBytesPerMicro	150			// 150 MB/s
+#define SSDReadLatency		80000
+#define SSDWriteLatency		200000
+#define SSDBytesPerMicro	500
+#define NVMeReadLatency		10000
+#define NVMeWriteLatency	20000
+#define NVMeBytesPerMicro	3000
+#define NVMeQueueDepth		32
+#define ZRAMDecompressLatency	1500
+#define ZRAMCompressLatency		4000
+#define QueueDepth			(StorageModel == StorageNVMe ? NVMeQueueDepth : 1)
+#define MaxQueueDepth		32
+
+// Page Walk: the page number splits into WalkLevels radix levels, one memory
+// access each. Walk caches keep the upper level entries (PML4, PDPT and PD).
+// Page numbers have 8 bits only, so a cache holding every prefix of the top
+// level could never miss: those layouts don't build
+#ifndef WalkLevels
+#define WalkLevels			1		// 1: flat Page Table
+#endif
+#if WalkLevels < 1 || WalkLevels > 4
+#error "Page walks have 1 to 4 levels (8 bit page numbers)"
+#endif
+#ifndef WalkCacheEntries
+#define WalkCacheEntries	2		// Entries of each upper level cache (0: no walk caches)
+#endif
+#define PageNumberBits		8		// log2(PagesAmount)
+#define LevelBits			((PageNumberBits + WalkLevels - 1)/WalkLevels)
+#define TopLevelBits		(PageNumberBits - LevelBits*(WalkLevels - 1))
+#if (1 << PageNumberBits) != PagesAmount
+#error "PageNumberBits must be log2(PagesAmount)"
+#endif
+#if WalkLevels > 1 && (TopLevelBits < 1 || (1 << TopLevelBits) <= WalkCacheEntries)
+#error "The walk caches can't miss on this many levels: use fewer levels or walk cache entries"
+#endif
+
+// TLB Prefetching: predicted translations of resident pages go on TLB after a miss
+#define TLBPrefetchNone		0
+#define TLBPrefetchSequential	1	// The TLBPrefetchDegree pages after a miss
+#define TLBPrefetchDistance	2		// The miss distances that followed the last one before
+#ifndef TLBPrefetchPolicy
+#define TLBPrefetchPolicy	TLBPrefetchNone
+#endif
+#define TLBPrefetchDegree	2
+#define DistanceTableEntries	64
+
+// NUMA: frames split evenly over NUMANodes nodes, remote accesses cost more
+#ifndef NUMANodes
+#define NUMANodes			1		// 1: uniform memory
+#endif
+#define PlacementFirstTouch	0		// On the node of the CPU touching the page first
+#define PlacementInterleave	1		// Round robin over the nodes, page by page
+#define PlacementBind		2		// On BindNode
+#ifndef PlacementPolicy
+#define PlacementPolicy		PlacementFirstTouch
+#endif
+#define BindNode			0
+#define FramesPerNode		(FramesAmount/NUMANodes)
+#define RemoteMemoryLatency	170		// One interconnect hop
+#ifndef MigrationThreshold
+#define MigrationThreshold	0		// Remote accesses before a page moves to the accessing node (0: never)
+#endif
+#define MigrationLatency	2000	// Page copy and TLB shootdown
+#if FramesAmount % NUMANodes
+#error "Every NUMA node needs the same number of frames"
+#endif
+
+// Compressed Swap (zswap): evicted pages are kept compressed in memory
+#ifndef CompressedSwap
+#define CompressedSwap		0
+#endif
+
+// Metadata Only: mappings and statistics without frame contents or Backing
+// Store I/O (values read as 0, the timing model still runs)
+#ifndef MetadataOnly
+#define MetadataOnly		0
+#endif
+#if MetadataOnly && CompressedSwap
+#error "The compressed pool needs the frame contents"
+#endif
+#define BackingStoreBytes	(MetadataOnly ? 0 : PagesAmount*FrameBytesSize)
+#define PoolBytes			(FramesAmount*FrameBytesSize/5)	// 20% of memory, like zswap
+#define CompressionHashBits	8
+#define MinMatch			4		// LZ4 block format
+
+// Batch Translation
+#define TranslationBatch	256		// References translated per batch
+#define BatchPrefetchDistance	(FramesAmount*FrameBytesSize > (1 << 20) ? 4 : 0)	// References ahead
+																	// prefetched (once memory outgrows the caches)
+
+// Time Series (statistics of every window of SnapshotWindow references)
+#ifndef SnapshotWindow
+#define SnapshotWindow		0		// 0: end of run totals only
+#endif
+#define CSVSnapshots		0		// One CSV row per window
+#define JSONSnapshots		1		// One JSON object per line and window
+#define SnapshotFormat		CSVSnapshots
+
+// Reuse distances (references between two accesses to a page), log2 buckets
+#define ReuseBuckets		64
+
+// Instrumented Stages
+#define ParseStage			0
+#define TLBStage			1
+#define PageTableStage		2
+#define ParallelProbeStage	3		// Assynchronous TLB and Page Table probes
+#define VictimStage			4
+#define BackingStoreStage	5
+#define OutputStage			6
+#define StagesAmount		7
+#define HistogramSubBuckets	16		// Buckets per power of two (~6% precision)
+#define HistogramBuckets	(64*HistogramSubBuckets)
+
+// Sampled Simulation (SMARTS): references fast-forwarded with functional
+// warming, DetailedWarming references with the timing model, then a window
+// measured. Functional warming still runs the TLB, Page Table and frames
+// (only timing and output lines are off), so it is not cheaper per reference
+#define DetailedWarming		2000
+#define SamplingConfidence	1.96	// 95% confidence intervals
+#define SampledMetrics		3		// Page fault rate, TLB hit rate, effective access time
+
+// Streaming Input (a reader thread parses the trace ahead of the translator)
+#define ReadBlockBytes		(1 << 16)	// Bytes of each read from the input
+#define RingBatches			16			// Parsed batches buffered at most
+#define PlainTrace			0
+#define GzipTrace			1			// Any number of concatenated members
+#define ZstdTrace			2			// Any number of frames
+#define TraceMagic			"MMTR"		// Binary traces (MemoryManager_TraceGenerator -b)
+#define TraceHeaderBytes	16			// Magic, version and reference count
+
+// Checkpoints (restored only by a simulator with the same state layout)
+#define CheckpointMagic		"MMCKPT1"
+#define CheckpointPolicy	"FIFO"
+#define CheckpointParts		16
 
 //Files
 #define inputfile_default "addresses.txt"
 #define backingStore_default "BACKING_STORE.bin"
+#define backingStoreCopy_default "BACKING_STORE_out.bin"
+#define timeseriesCSV_default "timeseries.csv"
+#define timeseriesJSON_default "timeseries.json"
+#define heatmap_default "heatmap.csv"
+#define reuse_default "reuse.csv"
+#define OutputPathLength	256
+#ifndef result_default
 #define result_default "result.txt"
+#endif
 
 /**
  * 	Memory Manager Structs
  */
 // Page Table (256 pages)
 typedef struct pageTable {
-	int frameNumber[PagesAmount];
-	unsigned int FIFO[FramesAmount];
+	unsigned int entry[PagesAmount];
+	// FIFO of resident pages (linked by page number, -1 off the list)
+	int older[PagesAmount], newer[PagesAmount];
+	int oldest, newest;
 } PageTable;
 
 // Page (256 bytes)
@@ -49,117 +274,1068 @@ typedef struct page {
 	char PageContent[FrameBytesSize];
 } Page;
 
-// TLB - Maps Pages on Physical Memory (16 entries)
+// TLB - Maps Pages on Physical Memory (16 entries). The tags probed on every
+// translation start on their own cache line
 typedef struct tlb {
-	int pageNumber[TLBEntriesAmount], frameNumber[TLBEntriesAmount];
+	int pageNumber[TLBEntriesAmount] __attribute__((aligned(CacheLineSize)));
+	int frameNumber[TLBEntriesAmount] __attribute__((aligned(CacheLineSize)));
 	unsigned int FIFO[TLBEntriesAmount];
+	unsigned char prefetched[TLBEntriesAmount];		// Inserted by the TLB prefetcher, not used yet
 } TLB;
 
-// Physical Memory (65.536 bytes)
+// Physical Memory (65.536 bytes) and frame metadata, one array per field
 typedef struct memory {
-	Page frame[FramesAmount];
-	int available[FramesAmount];
+	Page frame[MetadataOnly ? 1 : FramesAmount];
+	unsigned long long availableBits[FrameWords];
+	unsigned long long summaryBits[SummaryWords];
+	int availableFrames;
+	unsigned char prefetched[FramesAmount];
 } Memory;
 
-// Statistics
-typedef struct statistics {
-	int TranslatedAddressesCounter;
-	int PageFaultsCounter;
-	int TLBHitsCounter;
-} Statistics;
+// Write Back Buffer - Dirty victims waiting to be written on the backing store
+typedef struct writeBuffer {
+	int pageNumber[WriteBackBatch];
+	Page page[MetadataOnly ? 1 : WriteBackBatch];
+	int count;
+} WriteBuffer;
+
+// Prefetcher - Fault stride and readahead window state, and the TLB miss
+// distances that followed each distance (newest first)
+typedef struct prefetcher {
+	int lastFaultPage, lastStride;
+	int windowStart, windowSize, windowMarker;
+	int lastMissPage, lastMissDistance;
+	int missDistance[DistanceTableEntries];
+	int nextDistance[DistanceTableEntries][TLBPrefetchDegree];
+} Prefetcher;
+
+// Page Walk Caches - Upper level entries of recent walks, one FIFO replaced
+// cache per level
+typedef struct walkCache {
+	int prefix[WalkLevels][WalkCacheEntries > 0 ? WalkCacheEntries : 1];
+	int next[WalkLevels];
+	int hits[WalkLevels];
+} WalkCache;
+
+// Heatmap - Accesses and faults of every page, indexed like the Page Table
+typedef struct heatmap {
+	unsigned int accesses[PagesAmount];
+	unsigned int faults[PagesAmount];
+	long long lastReference[PagesAmount];
+	long long reuseDistance[ReuseBuckets];
+	long long coldReferences, references;
+} Heatmap;
+
+// Storage - Requests in service on the device (min-heap of completion times)
+typedef struct storage {
+	unsigned long long completion[MaxQueueDepth];
+	int pending;
+	int headPosition;								// HDD head, as a page number
+	unsigned long long readyTime[FramesAmount];		// Completion of each prefetch read
+} Storage;
+
+// Compressed Pool - Evicted pages kept compressed, from the oldest to the newest
+typedef struct compressedPool {
+	unsigned char *data[PagesAmount];	// NULL when the page is not on the pool
+	short size[PagesAmount];
+	unsigned char dirty[PagesAmount];	// Newer than the Backing Store
+	int older[PagesAmount], newer[PagesAmount];
+	int oldest, newest;
+	int bytes;
+} CompressedPool;
+
+// NUMA - Node of the running CPU and remote accesses of every resident page
+typedef struct numa {
+	int node;
+	unsigned int remoteAccesses[PagesAmount];
+} NUMA;
+
+// Stage Profile - Ticks spent on one stage, with an HDR-style histogram
+typedef struct stageProfile {
+	unsigned long long count, total, min, max;
+	unsigned long long bucket[HistogramBuckets];
+} StageProfile;
+
+// Checkpoint Header - Layout of the simulator that wrote the checkpoint
+typedef struct checkpointHeader {
+	char magic[8];
+	char policy[8];
+	int pagesAmount, frameBytesSize;
+	unsigned long long stateBytes;		// Bytes of the fixed size parts
+	long long tracePosition;
+} CheckpointHeader;
+
+// Memory Manager context (libmemmgr.h) - The whole state of one simulated memory
+struct memoryManager {
+	FILE *backingStore, *timeseries;
+	Statistics *statistics;
+	PageTable *pageTable;
+	Memory *memory;
+	Page *page;
+	TLB *TLB;
+	WriteBuffer *writeBuffer;
+	Prefetcher *prefetcher;
+	WalkCache *walkCache;
+	Storage *storage;
+	CompressedPool *pool;
+	NUMA *numa;
+	Statistics lastSnapshot;
+	Heatmap *heatmap;
+	int snapshotsCounter;
+#if Instrumentation
+	StageProfile *profile;
+#endif
+	pthread_t threads[NumThreads];
+	pthread_mutex_t mutex;
+	int pageOnTLB;
+	int functionalWarming;		// Tables and queues only, the timing model is off
+	char outputPrefix[OutputPathLength];	// Before the names of the output files
+};
 
 /**
  * 	Threads
  */
-pthread_t threads[NumThreads];
-pthread_mutex_t mutex;
 typedef struct {
 	int pageNumber, frameNumber;
+	MemoryManager *context;
 }thread_arg, *ptr_thread_arg;
-int pageOnTLB;
 
 /**
  * 	Program Global Variables
  */
-FILE *addresses, *result, *backingStore;
-char line[MaxStringLength] = "";
+// Context of the running Memory Manager, set by every library method. Each
+// thread has its own, so different Memory Managers run on different threads
+__thread MemoryManager *_context;
+
+#define _backingStore		(_context->backingStore)
+#define _timeseries			(_context->timeseries)
+#define _statistics			(_context->statistics)
+#define _pageTable			(_context->pageTable)
+#define _memory				(_context->memory)
+#define _page				(_context->page)
+#define _TLB				(_context->TLB)
+#define _writeBuffer		(_context->writeBuffer)
+#define _prefetcher			(_context->prefetcher)
+#define _walkCache			(_context->walkCache)
+#define _storage			(_context->storage)
+#define _pool				(_context->pool)
+#define _numa				(_context->numa)
+#define _lastSnapshot		(_context->lastSnapshot)
+#define _heatmap			(_context->heatmap)
+#define _snapshotsCounter	(_context->snapshotsCounter)
+#define _profile			(_context->profile)
+#define _threads			(_context->threads)
+#define _mutex				(_context->mutex)
+#define _pageOnTLB			(_context->pageOnTLB)
+#define _functionalWarming	(_context->functionalWarming)
+#define _outputPrefix		(_context->outputPrefix)
+
+const char *storageNames[] = {"None", "HDD", "SSD", "NVMe", "ZRAM"};
+const char *placementNames[] = {"First Touch", "Interleave", "Bind"};
+const char *walkLevelNames[] = {"PT", "PD", "PDPT", "PML4"};	// From the last level up
+
+/**
+ * 	Instrumentation methods
+ */
+#if Instrumentation
+const char *stageNames[StagesAmount] = {"Parse", "TLB Probe", "Page Table Walk",
+	"Parallel Probe", "Victim Selection", "Backing Store Read", "Output Write"};
+
+// Timestamp in cycles (x86) or nanoseconds
+static inline unsigned long long readTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+// Log-linear bucket: exact below HistogramSubBuckets, then 16 per power of two
+static inline int histogramBucket(unsigned long long ticks)
+{
+	if (ticks < HistogramSubBuckets)
+		return ticks;
+	int exponent = 63 - __builtin_clzll(ticks);
+	int subBucket = (ticks >> (exponent - 4)) & (HistogramSubBuckets - 1);
+	return (exponent - 3)*HistogramSubBuckets + subBucket;
+}
+
+// Lowest value counted on a bucket
+unsigned long long histogramValue(int bucket)
+{
+	if (bucket < HistogramSubBuckets)
+		return bucket;
+	int exponent = bucket/HistogramSubBuckets + 3;
+	return (unsigned long long)(HistogramSubBuckets + bucket % HistogramSubBuckets) << (exponent - 4);
+}
+
+// Recording the ticks of one stage execution
+static inline void recordStage(int stage, unsigned long long ticks)
+{
+	StageProfile *profile = &_profile[stage];
+	if (profile->count == 0 || ticks < profile->min)
+		profile->min = ticks;
+	if (ticks > profile->max)
+		profile->max = ticks;
+	profile->count++;
+	profile->total += ticks;
+	profile->bucket[histogramBucket(ticks)]++;
+}
+
+// Value below which a fraction of the stage executions fall
+unsigned long long stagePercentile(StageProfile *profile, double fraction)
+{
+	unsigned long long target = fraction*profile->count, seen = 0;
+	for (int i = 0; i < HistogramBuckets; i++) {
+		seen += profile->bucket[i];
+		if (seen > target)
+			return histogramValue(i) < profile->max ? histogramValue(i) : profile->max;
+	}
+	return profile->max;
+}
+
+// Instrumentation Output Log (after the statistics)
+void instrumentationLog(FILE *result)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	const char *unit = "cycles";
+#else
+	const char *unit = "ns";
+#endif
+	fprintf(result, "Stage Timing (%s)\n", unit);
+	fprintf(result, "%-20s %10s %14s %10s %8s %8s %8s %8s %8s %10s\n", "Stage", "Count",
+		"Total", "Mean", "Min", "p50", "p90", "p99", "p99.9", "Max");
+	for (int i = 0; i < StagesAmount; i++) {
+		StageProfile *profile = &_profile[i];
+		if (profile->count == 0)
+			continue;
+		fprintf(result, "%-20s %10llu %14llu %10.1f %8llu %8llu %8llu %8llu %8llu %10llu\n",
+			stageNames[i], profile->count, profile->total, (double)profile->total/profile->count,
+			profile->min, stagePercentile(profile, 0.5), stagePercentile(profile, 0.9),
+			stagePercentile(profile, 0.99), stagePercentile(profile, 0.999), profile->max);
+	}
+}
+
+#define StageStart(name)		unsigned long long name##Ticks = readTicks()
+#define StageStop(stage, name)	recordStage(stage, readTicks() - name##Ticks)
+#else
+#define StageStart(name)
+#define StageStop(stage, name)
+#endif
+
+/**
+ * 	Frame Availability methods
+ */
+// Number of available frames
+int countAvailableFrames()
+{
+	return _memory->availableFrames;
+}
+
+// Taking the lowest available frame (-1 when memory is full). The summary
+// finds the first non empty bitset word, 4096 frames per summary word
+int takeAvailableFrame()
+{
+	for (int i = 0; i < SummaryWords; i++)
+		if (_memory->summaryBits[i]) {
+			int word = i*64 + __builtin_ctzll(_memory->summaryBits[i]);
+			int bit = __builtin_ctzll(_memory->availableBits[word]);
+			_memory->availableBits[word] &= _memory->availableBits[word] - 1;
+			if (_memory->availableBits[word] == 0)
+				_memory->summaryBits[i] &= ~(1ULL << (word & 63));
+			_memory->availableFrames--;
+			return word*64 + bit;
+		}
+	return -1;
+}
+
+// Returning a frame to the available ones
+void releaseFrame(int frameNumber)
+{
+	int word = frameNumber >> 6;
+	_memory->availableBits[word] |= 1ULL << (frameNumber & 63);
+	_memory->summaryBits[word >> 6] |= 1ULL << (word & 63);
+	_memory->availableFrames++;
+}
+
+// Node of a frame
+static inline int frameNode(int frameNumber)
+{
+	return frameNumber/FramesPerNode;
+}
+
+// Taking the lowest available frame of a node (-1 when the node is full)
+int takeAvailableFrameOnNode(int node)
+{
+	int first = node*FramesPerNode, last = first + FramesPerNode - 1;
+	for (int word = first >> 6; word <= last >> 6; word++) {
+		unsigned long long bits = _memory->availableBits[word];
+		if (word == first >> 6)
+			bits &= ~0ULL << (first & 63);
+		if (word == last >> 6 && (last & 63) != 63)
+			bits &= (2ULL << (last & 63)) - 1;
+		if (bits) {
+			int frameNumber = word*64 + __builtin_ctzll(bits);
+			_memory->availableBits[word] &= ~(1ULL << (frameNumber & 63));
+			if (_memory->availableBits[word] == 0)
+				_memory->summaryBits[word >> 6] &= ~(1ULL << (word & 63));
+			_memory->availableFrames--;
+			return frameNumber;
+		}
+	}
+	return -1;
+}
+
+// Taking an available frame for a page on the node of the placement policy,
+// or on the next ones when that node is full (-1 when memory is full)
+int takePlacedFrame(int pageNumber)
+{
+	if (NUMANodes == 1)
+		return takeAvailableFrame();
+
+	int node = PlacementPolicy == PlacementInterleave ? pageNumber % NUMANodes
+		: PlacementPolicy == PlacementBind ? BindNode : _numa->node;
+	for (int i = 0; i < NUMANodes; i++) {
+		int frameNumber = takeAvailableFrameOnNode((node + i) % NUMANodes);
+		if (frameNumber != -1)
+			return frameNumber;
+	}
+	return -1;
+}
 
-Statistics *_statistics;
-PageTable *_pageTable;
-Memory *_memory;
-Page *_page;
-TLB *_TLB;
+/**
+ * 	Input parsing methods
+ */
+// Parsing a trace line "address [R|W [value]]" (returns the fields read)
+int parseLine(char *line, int *virtualAddress, char *access, int *writeValue)
+{
+	*virtualAddress = *writeValue = 0;
+	*access = 'R';
+	return sscanf(line, "%d %c %d", virtualAddress, access, writeValue);
+}
 
 /**
  * 	Output results methods
  */
 // Write Output results
-void writeOut(int virtualAddress, int realAddress, int value)
+void writeOut(FILE *result, int virtualAddress, int realAddress, int value)
 {
 	fprintf(result, "Virtual address: %d ", virtualAddress);
     fprintf(result, "Physical address: %d ", realAddress);
     fprintf(result, "Value: %d\n", value);
-    _statistics->TranslatedAddressesCounter++;
 }
 
 // Statistics Output Log
-void statisticsLog()
+void statisticsLog(FILE *result)
 {
 	float pageFaultRate = _statistics->PageFaultsCounter;
 		  pageFaultRate = pageFaultRate/_statistics->TranslatedAddressesCounter;
 	float tlbHitsRate = _statistics->TLBHitsCounter;
 		  tlbHitsRate = tlbHitsRate/_statistics->TranslatedAddressesCounter;
-	fprintf(result, "Number of Translated Addresses = %d\n", _statistics->TranslatedAddressesCounter);
-	fprintf(result, "Page Faults = %d\n", _statistics->PageFaultsCounter);
+	fprintf(result, "Number of Translated Addresses = %lld\n", _statistics->TranslatedAddressesCounter);
+	fprintf(result, "Page Faults = %lld\n", _statistics->PageFaultsCounter);
 	fprintf(result, "Page Fault Rate = %.3f\n", pageFaultRate);
-	fprintf(result, "TLB Hits = %d\n", _statistics->TLBHitsCounter);
+	fprintf(result, "TLB Hits = %lld\n", _statistics->TLBHitsCounter);
 	fprintf(result, "TLB Hit Rate = %.3f\n", tlbHitsRate);
+
+	// Write statistics (only for read/write traces)
+	if (_statistics->WritesCounter > 0) {
+		fprintf(result, "Writes = %lld\n", _statistics->WritesCounter);
+		fprintf(result, "Dirty Evictions = %lld\n", _statistics->DirtyEvictionsCounter);
+		fprintf(result, "Coalesced Write Backs = %lld\n", _statistics->CoalescedWriteBacksCounter);
+		fprintf(result, "Backing Store Writes = %lld\n", _statistics->BackingStoreWritesCounter);
+	}
+
+	// Prefetch statistics (prefetched pages still unused at the end are wasted too)
+	if (PrefetchPolicy != PrefetchNone) {
+		long long wastedPrefetches = _statistics->WastedPrefetchesCounter;
+		for (int i = 0; i < FramesAmount; i++)
+			wastedPrefetches += _memory->prefetched[i];
+		float prefetchAccuracy = _statistics->UsefulPrefetchesCounter;
+			  prefetchAccuracy = _statistics->PrefetchedPagesCounter ? prefetchAccuracy/_statistics->PrefetchedPagesCounter : 0;
+		float prefetchCoverage = _statistics->UsefulPrefetchesCounter;
+			  prefetchCoverage = prefetchCoverage/(_statistics->UsefulPrefetchesCounter + _statistics->PageFaultsCounter);
+		fprintf(result, "Prefetched Pages = %lld\n", _statistics->PrefetchedPagesCounter);
+		fprintf(result, "Prefetch Reads = %lld\n", _statistics->PrefetchReadsCounter);
+		fprintf(result, "Prefetch Accuracy = %.3f\n", prefetchAccuracy);
+		fprintf(result, "Prefetch Coverage = %.3f\n", prefetchCoverage);
+		fprintf(result, "Wasted Prefetches = %lld\n", wastedPrefetches);
+	}
+
+	// Simulated time of the storage model
+	if (StorageModel != StorageNone) {
+		fprintf(result, "Storage Model = %s\n", storageNames[StorageModel]);
+		fprintf(result, "Device Requests = %lld\n", _statistics->DeviceRequestsCounter);
+		fprintf(result, "Simulated Time = %.3f ms\n", _statistics->SimulatedTime/1e6);
+		fprintf(result, "Fault Stall Time = %.3f ms\n", _statistics->FaultStallTime/1e6);
+		fprintf(result, "Effective Access Time = %.1f ns\n",
+			(double)_statistics->SimulatedTime/_statistics->TranslatedAddressesCounter);
+	}
+
+	// Compressed pool statistics (every pool hit is a Backing Store read saved)
+	if (CompressedSwap) {
+		float compressionRatio = _statistics->PoolStoredBytes;
+			  compressionRatio = _statistics->PoolCompressedBytes ? compressionRatio/_statistics->PoolCompressedBytes : 0;
+		fprintf(result, "Pool Stores = %lld\n", _statistics->PoolStoresCounter);
+		fprintf(result, "Pool Rejected Pages = %lld\n", _statistics->PoolRejectedCounter);
+		fprintf(result, "Compression Ratio = %.3f\n", compressionRatio);
+		fprintf(result, "Pool Hits = %lld\n", _statistics->PoolHitsCounter);
+		fprintf(result, "Backing Store Reads Saved = %lld\n", _statistics->PoolHitsCounter);
+		fprintf(result, "Pool Write Backs = %lld\n", _statistics->PoolWriteBacksCounter);
+	}
+
+	// Page walk statistics (a walk cache hit skips the levels above it)
+	if (WalkLevels > 1) {
+		float walkCacheHitRate = _statistics->WalkCacheHitsCounter;
+			  walkCacheHitRate = _statistics->PageWalksCounter ? walkCacheHitRate/_statistics->PageWalksCounter : 0;
+		fprintf(result, "Page Walks = %lld\n", _statistics->PageWalksCounter);
+		fprintf(result, "Walk Memory Accesses = %lld\n", _statistics->WalkMemoryAccessesCounter);
+		fprintf(result, "Walk Cache Hit Rate = %.3f\n", walkCacheHitRate);
+		for (int level = 0; level < WalkLevels - 1; level++)
+			fprintf(result, "%s Cache Hit Rate = %.3f\n", walkLevelNames[WalkLevels - 1 - level],
+				_statistics->PageWalksCounter ? (float)_walkCache->hits[level]/_statistics->PageWalksCounter : 0);
+	}
+
+	// TLB prefetch statistics (every prefetched translation used is a TLB miss eliminated)
+	if (TLBPrefetchPolicy != TLBPrefetchNone) {
+		float TLBPrefetchAccuracy = _statistics->UsefulTLBPrefetchesCounter;
+			  TLBPrefetchAccuracy = _statistics->TLBPrefetchesCounter ? TLBPrefetchAccuracy/_statistics->TLBPrefetchesCounter : 0;
+		fprintf(result, "TLB Prefetches = %lld\n", _statistics->TLBPrefetchesCounter);
+		fprintf(result, "TLB Misses Eliminated = %lld\n", _statistics->UsefulTLBPrefetchesCounter);
+		fprintf(result, "TLB Prefetch Accuracy = %.3f\n", TLBPrefetchAccuracy);
+	}
+
+	// NUMA statistics (every data access is local or remote)
+	if (NUMANodes > 1) {
+		float localRatio = _statistics->LocalAccessesCounter;
+			  localRatio = localRatio/(_statistics->LocalAccessesCounter + _statistics->RemoteAccessesCounter);
+		fprintf(result, "NUMA Nodes = %d\n", NUMANodes);
+		fprintf(result, "Placement Policy = %s\n", placementNames[PlacementPolicy]);
+		fprintf(result, "Local Accesses = %lld\n", _statistics->LocalAccessesCounter);
+		fprintf(result, "Remote Accesses = %lld\n", _statistics->RemoteAccessesCounter);
+		fprintf(result, "Local Access Ratio = %.3f\n", localRatio);
+		fprintf(result, "Page Migrations = %lld\n", _statistics->MigrationsCounter);
+	}
+
+#if Instrumentation
+	instrumentationLog(result);
+#endif
+}
+
+// Opening an output file of the running context (NULL when it can't be written)
+FILE *openOutput(const char *name)
+{
+	char path[OutputPathLength + 32];	// Prefix and the longest file name
+	snprintf(path, sizeof(path), "%s%s", _outputPrefix, name);
+	return fopen(path, "w");
+}
+
+// Snapshot of the window ended now (counters are the differences between
+// the cumulative statistics and the ones of the last snapshot)
+void snapshotLog()
+{
+	int references = _statistics->TranslatedAddressesCounter - _lastSnapshot.TranslatedAddressesCounter;
+	if (references == 0)
+		return;
+
+	// Opened on the first window, once the output prefix is set
+	if (_timeseries == NULL) {
+		_timeseries = openOutput(SnapshotFormat == JSONSnapshots ? timeseriesJSON_default : timeseriesCSV_default);
+		if (_timeseries == NULL)
+			return;
+		if (SnapshotFormat == CSVSnapshots)
+			fprintf(_timeseries, "window,end,references,page_faults,page_fault_rate,"
+				"tlb_hits,tlb_hit_rate,resident_pages,evictions\n");
+	}
+	int pageFaults = _statistics->PageFaultsCounter - _lastSnapshot.PageFaultsCounter;
+	int TLBHits = _statistics->TLBHitsCounter - _lastSnapshot.TLBHitsCounter;
+	int evictions = _statistics->EvictionsCounter - _lastSnapshot.EvictionsCounter;
+	float pageFaultRate = (float)pageFaults/references;
+	float tlbHitsRate = (float)TLBHits/references;
+
+	int residentPages = FramesAmount - countAvailableFrames();
+
+	if (SnapshotFormat == JSONSnapshots)
+		fprintf(_timeseries, "{\"window\": %d, \"end\": %lld, \"references\": %d, \"pageFaults\": %d, "
+			"\"pageFaultRate\": %.3f, \"TLBHits\": %d, \"TLBHitRate\": %.3f, "
+			"\"residentPages\": %d, \"evictions\": %d}\n", _snapshotsCounter,
+			_statistics->TranslatedAddressesCounter, references, pageFaults, pageFaultRate,
+			TLBHits, tlbHitsRate, residentPages, evictions);
+	else
+		fprintf(_timeseries, "%d,%lld,%d,%d,%.3f,%d,%.3f,%d,%d\n", _snapshotsCounter,
+			_statistics->TranslatedAddressesCounter, references, pageFaults, pageFaultRate,
+			TLBHits, tlbHitsRate, residentPages, evictions);
+
+	// Readable while the run is in progress
+	fflush(_timeseries);
+	_lastSnapshot = *_statistics;
+	_snapshotsCounter++;
+}
+
+/**
+ * 	Profiler methods
+ */
+// Counting an access to a page and the distance since its last access
+void profilePageAccess(int pageNumber)
+{
+	long long reference = ++_heatmap->references;
+	long long last = _heatmap->lastReference[pageNumber];
+	_heatmap->accesses[pageNumber]++;
+	_heatmap->lastReference[pageNumber] = reference;
+
+	if (last == 0)
+		_heatmap->coldReferences++;
+	else
+		_heatmap->reuseDistance[63 - __builtin_clzll(reference - last)]++;
+}
+
+// Heatmap and reuse distance histogram Output
+void profileLog()
+{
+	FILE *heatmap = openOutput(heatmap_default);
+	if (heatmap == NULL)
+		return;
+	fprintf(heatmap, "page,accesses,faults\n");
+	for (int i = 0; i < PagesAmount; i++)
+		if (_heatmap->accesses[i] > 0 || _heatmap->faults[i] > 0)
+			fprintf(heatmap, "%d,%u,%u\n", i, _heatmap->accesses[i], _heatmap->faults[i]);
+	fclose(heatmap);
+
+	// Bucket b counts distances in [2^b, 2^(b+1)); cold references have none
+	FILE *reuse = openOutput(reuse_default);
+	if (reuse == NULL)
+		return;
+	fprintf(reuse, "distance_from,distance_to,references\n");
+	fprintf(reuse, "cold,cold,%lld\n", _heatmap->coldReferences);
+	for (int i = 0; i < ReuseBuckets; i++)
+		if (_heatmap->reuseDistance[i] > 0)
+			fprintf(reuse, "%llu,%llu,%lld\n", 1ULL << i, (2ULL << i) - 1, _heatmap->reuseDistance[i]);
+	fclose(reuse);
+}
+
+/**
+ * 	Storage Model methods
+ */
+// Advancing the simulated clock
+static inline void advanceClock(unsigned long long time)
+{
+	if (StorageModel != StorageNone && !_functionalWarming)
+		_statistics->SimulatedTime += time;
+}
+
+// Stalling until the device completes a request
+void stallUntil(unsigned long long time)
+{
+	if (StorageModel != StorageNone && !_functionalWarming && time > (unsigned long long)_statistics->SimulatedTime) {
+		_statistics->FaultStallTime += time - _statistics->SimulatedTime;
+		_statistics->SimulatedTime = time;
+	}
+}
+
+// Service time of a request of count contiguous pages
+unsigned long long serviceTime(int pageNumber, int count, int write)
+{
+	unsigned long long bytes = (unsigned long long)count*FrameBytesSize;
+
+	if (StorageModel == StorageHDD) {
+		int distance = abs(pageNumber - _storage->headPosition);
+		double seek = distance ? HDDMinSeek + (HDDMaxSeek - HDDMinSeek)*sqrt((double)distance/PagesAmount) : 0;
+		_storage->headPosition = pageNumber + count;
+		return seek + HDDRotation/2 + bytes*1000/HDDBytesPerMicro;
+	}
+	if (StorageModel == StorageSSD)
+		return (write ? SSDWriteLatency : SSDReadLatency) + bytes*1000/SSDBytesPerMicro;
+	if (StorageModel == StorageNVMe)
+		return (write ? NVMeWriteLatency : NVMeReadLatency) + bytes*1000/NVMeBytesPerMicro;
+	return (unsigned long long)count*(write ? ZRAMCompressLatency : ZRAMDecompressLatency);
+}
+
+// Removing the earliest completion from the heap
+unsigned long long popCompletion()
+{
+	unsigned long long *heap = _storage->completion;
+	unsigned long long earliest = heap[0];
+	unsigned long long last = heap[--_storage->pending];
+
+	int i = 0;
+	for (int child = 1; child < _storage->pending; i = child, child = 2*i + 1) {
+		if (child + 1 < _storage->pending && heap[child + 1] < heap[child])
+			child++;
+		if (last <= heap[child])
+			break;
+		heap[i] = heap[child];
+	}
+	heap[i] = last;
+	return earliest;
+}
+
+// Adding a completion to the heap
+void pushCompletion(unsigned long long time)
+{
+	unsigned long long *heap = _storage->completion;
+	int i = _storage->pending++;
+	for (; i > 0 && heap[(i - 1)/2] > time; i = (i - 1)/2)
+		heap[i] = heap[(i - 1)/2];
+	heap[i] = time;
+}
+
+// Issuing a request now: it starts once a queue slot is free. Returns its
+// completion time (ZRAM compression runs on the CPU, so writes stall too)
+unsigned long long scheduleRequest(int pageNumber, int count, int write)
+{
+	if (StorageModel == StorageNone || _functionalWarming)
+		return 0;
+
+	unsigned long long start = _statistics->SimulatedTime;
+	while (_storage->pending > 0 && _storage->completion[0] <= start)
+		popCompletion();
+	if (_storage->pending == QueueDepth)
+		start = popCompletion();
+
+	unsigned long long completion = start + serviceTime(pageNumber, count, write);
+	pushCompletion(completion);
+	_statistics->DeviceRequestsCounter++;
+
+	if (write && StorageModel == StorageZRAM)
+		stallUntil(completion);
+	return completion;
+}
+
+/**
+ * 	Backing Store Write Back methods
+ */
+// Copying the Backing Store so write backs never touch the original file
+// (NULL when a file can't be opened, a temporary copy without copyfile)
+FILE *copyBackingStore(const char *originalfile, const char *copyfile)
+{
+	FILE *original = fopen(originalfile, "rb");
+	if (original == NULL)
+		return NULL;
+	FILE *copy = copyfile ? fopen(copyfile, "w+b") : tmpfile();
+	char buffer[4096];
+	size_t bytes;
+
+	while (copy && (bytes = fread(buffer, 1, sizeof(buffer), original)) > 0)
+		fwrite(buffer, 1, bytes, copy);
+	fclose(original);
+	return copy;
+}
+
+// Finding a pending Page on the Write Back Buffer
+int findPageOnWriteBuffer(int pageNumber)
+{
+	for (int i = 0; i < _writeBuffer->count; i++)
+		if (_writeBuffer->pageNumber[i] == pageNumber)
+			return i;
+	return -1;
+}
+
+// Flushing the Write Back Buffer: one write per run of contiguous pages
+void flushWriteBuffer()
+{
+	// Sort pending pages by page number
+	for (int i = 1; i < _writeBuffer->count; i++) {
+		int pageNumber = _writeBuffer->pageNumber[i];
+		Page page = _writeBuffer->page[MetadataOnly ? 0 : i];
+		int j = i - 1;
+		for (; j >= 0 && _writeBuffer->pageNumber[j] > pageNumber; j--) {
+			_writeBuffer->pageNumber[j+1] = _writeBuffer->pageNumber[j];
+			if (!MetadataOnly)
+				_writeBuffer->page[j+1] = _writeBuffer->page[j];
+		}
+		_writeBuffer->pageNumber[j+1] = pageNumber;
+		if (!MetadataOnly)
+			_writeBuffer->page[j+1] = page;
+	}
+
+	for (int start = 0, end; start < _writeBuffer->count; start = end) {
+		end = start + 1;
+		while (end < _writeBuffer->count && _writeBuffer->pageNumber[end] == _writeBuffer->pageNumber[end-1] + 1)
+			end++;
+		if (!MetadataOnly) {
+			fseek(_backingStore, _writeBuffer->pageNumber[start]*FrameBytesSize, SEEK_SET);
+			fwrite(_writeBuffer->page[start].PageContent, FrameBytesSize, end - start, _backingStore);
+		}
+		_statistics->BackingStoreWritesCounter++;
+		scheduleRequest(_writeBuffer->pageNumber[start], end - start, 1);
+	}
+	_writeBuffer->count = 0;
+}
+
+// Queueing a page content on the Write Back Buffer
+void queuePageWriteBack(int pageNumber, Page *page)
+{
+	int index = findPageOnWriteBuffer(pageNumber);
+
+	// Same page already pending: the newer content replaces it
+	if (index != -1)
+		_statistics->CoalescedWriteBacksCounter++;
+	else {
+		if (_writeBuffer->count == WriteBackBatch)
+			flushWriteBuffer();
+		index = _writeBuffer->count++;
+		_writeBuffer->pageNumber[index] = pageNumber;
+	}
+	if (!MetadataOnly)
+		_writeBuffer->page[index] = *page;
+}
+
+// Queueing a frame content on the Write Back Buffer
+void queueWriteBack(int pageNumber, int frameNumber)
+{
+	queuePageWriteBack(pageNumber, &_memory->frame[MetadataOnly ? 0 : frameNumber]);
+	_pageTable->entry[pageNumber] &= ~EntryDirty;
+}
+
+/**
+ * 	Compression methods (LZ4 block format)
+ */
+// Writing the rest of a length of 15 or more: 255 valued bytes and the remainder
+static inline int writeLength(unsigned char *destination, int out, int length)
+{
+	for (; length >= 255; length -= 255)
+		destination[out++] = 255;
+	destination[out++] = length;
+	return out;
+}
+
+// Compressing a page into sequences of a token (literals and match lengths),
+// the literals and the 16-bit offset of the match. Returns the compressed
+// size, or FrameBytesSize when the page does not get any smaller
+int compressPage(const unsigned char *source, unsigned char *destination)
+{
+	unsigned short table[1 << CompressionHashBits];		// Last position + 1 of each hash
+	int anchor = 0, out = 0;
+	memset(table, 0, sizeof(table));
+
+	for (int i = 0; i + MinMatch <= FrameBytesSize; ) {
+		unsigned int sequence;
+		memcpy(&sequence, source + i, MinMatch);
+		unsigned int hash = (sequence*2654435761u) >> (32 - CompressionHashBits);
+		int candidate = table[hash] - 1;
+		table[hash] = i + 1;
+		if (candidate < 0 || memcmp(source + candidate, source + i, MinMatch) != 0) {
+			i++;
+			continue;
+		}
+
+		int length = MinMatch;
+		while (i + length < FrameBytesSize && source[candidate + length] == source[i + length])
+			length++;
+
+		// Token, literals, offset and lengths must fit before the page size
+		int literals = i - anchor, matchLength = length - MinMatch;
+		if (out + 1 + literals/255 + 1 + literals + 2 + matchLength/255 + 1 >= FrameBytesSize)
+			return FrameBytesSize;
+		destination[out++] = (literals < 15 ? literals : 15) << 4 | (matchLength < 15 ? matchLength : 15);
+		if (literals >= 15)
+			out = writeLength(destination, out, literals - 15);
+		memcpy(destination + out, source + anchor, literals);
+		out += literals;
+		destination[out++] = (i - candidate) & 0xFF;
+		destination[out++] = (i - candidate) >> 8;
+		if (matchLength >= 15)
+			out = writeLength(destination, out, matchLength - 15);
+		i += length;
+		anchor = i;
+	}
+
+	// Last literals, without a match
+	int literals = FrameBytesSize - anchor;
+	if (out + 1 + literals/255 + 1 + literals >= FrameBytesSize)
+		return FrameBytesSize;
+	destination[out++] = (literals < 15 ? literals : 15) << 4;
+	if (literals >= 15)
+		out = writeLength(destination, out, literals - 15);
+	memcpy(destination + out, source + anchor, literals);
+	return out + literals;
+}
+
+// Decompressing a page compressed by compressPage
+void decompressPage(const unsigned char *source, int size, unsigned char *destination)
+{
+	int in = 0, out = 0;
+
+	while (in < size) {
+		int token = source[in++];
+		int literals = token >> 4;
+		if (literals == 15)
+			do literals += source[in]; while (source[in++] == 255);
+		memcpy(destination + out, source + in, literals);
+		in += literals;
+		out += literals;
+		if (in >= size)
+			break;
+
+		// Matches may overlap the bytes they produce
+		int offset = source[in] | source[in + 1] << 8;
+		int length = (token & 15) + MinMatch;
+		in += 2;
+		if ((token & 15) == 15)
+			do length += source[in]; while (source[in++] == 255);
+		for (; length > 0; length--, out++)
+			destination[out] = destination[out - offset];
+	}
+}
+
+/**
+ * 	Compressed Pool methods
+ */
+// Removing a page from the pool
+void removeFromPool(int pageNumber)
+{
+	if (_pool->older[pageNumber] != -1)
+		_pool->newer[_pool->older[pageNumber]] = _pool->newer[pageNumber];
+	else
+		_pool->oldest = _pool->newer[pageNumber];
+	if (_pool->newer[pageNumber] != -1)
+		_pool->older[_pool->newer[pageNumber]] = _pool->older[pageNumber];
+	else
+		_pool->newest = _pool->older[pageNumber];
+
+	_pool->bytes -= _pool->size[pageNumber];
+	free(_pool->data[pageNumber]);
+	_pool->data[pageNumber] = NULL;
+}
+
+// Evicting the oldest page of the pool, written back if dirty
+void evictOldestFromPool()
+{
+	int pageNumber = _pool->oldest;
+	if (_pool->dirty[pageNumber]) {
+		Page page;
+		decompressPage(_pool->data[pageNumber], _pool->size[pageNumber], (unsigned char*)page.PageContent);
+		queuePageWriteBack(pageNumber, &page);
+		_statistics->PoolWriteBacksCounter++;
+	}
+	removeFromPool(pageNumber);
+}
+
+// Keeping an evicted page compressed on the pool (0 when it does not compress)
+int storeOnPool(int pageNumber, int frameNumber, int dirty)
+{
+	unsigned char compressed[FrameBytesSize];
+	int size = compressPage((unsigned char*)_memory->frame[frameNumber].PageContent, compressed);
+	stallUntil(_statistics->SimulatedTime + ZRAMCompressLatency);
+	if (size >= FrameBytesSize || size > PoolBytes) {
+		_statistics->PoolRejectedCounter++;
+		return 0;
+	}
+
+	while (_pool->bytes + size > PoolBytes)
+		evictOldestFromPool();
+	_pool->data[pageNumber] = (unsigned char*)malloc(size);
+	memcpy(_pool->data[pageNumber], compressed, size);
+	_pool->size[pageNumber] = size;
+	_pool->dirty[pageNumber] = dirty;
+
+	// Newest page of the pool
+	_pool->older[pageNumber] = _pool->newest;
+	_pool->newer[pageNumber] = -1;
+	if (_pool->newest != -1)
+		_pool->newer[_pool->newest] = pageNumber;
+	else
+		_pool->oldest = pageNumber;
+	_pool->newest = pageNumber;
+	_pool->bytes += size;
+
+	_statistics->PoolStoresCounter++;
+	_statistics->PoolStoredBytes += FrameBytesSize;
+	_statistics->PoolCompressedBytes += size;
+	return 1;
+}
+
+// Loading a page kept on the pool into a frame (0 when it is not there).
+// A page newer than the Backing Store stays dirty on the Page Table
+int loadFromPool(int pageNumber, int frameNumber)
+{
+	if (_pool->data[pageNumber] == NULL)
+		return 0;
+
+	decompressPage(_pool->data[pageNumber], _pool->size[pageNumber],
+		(unsigned char*)_memory->frame[frameNumber].PageContent);
+	stallUntil(_statistics->SimulatedTime + ZRAMDecompressLatency);
+	if (_pool->dirty[pageNumber])
+		_pageTable->entry[pageNumber] |= EntryDirty;
+	removeFromPool(pageNumber);
+	return 1;
+}
+
+// Writing back an evicted Page if it is dirty, unless the pool keeps it
+void writeBackPage(int pageNumber, int frameNumber)
+{
+	int dirty = (_pageTable->entry[pageNumber] & EntryDirty) != 0;
+	if (dirty)
+		_statistics->DirtyEvictionsCounter++;
+	if (CompressedSwap && storeOnPool(pageNumber, frameNumber, dirty))
+		return;
+	if (dirty)
+		queueWriteBack(pageNumber, frameNumber);
+}
+
+// Writing back every dirty resident or pooled Page at the end of the run
+void syncBackingStore()
+{
+	for (int i = 0; i < PagesAmount; i++)
+		if ((_pageTable->entry[i] & (EntryValid | EntryDirty)) == (EntryValid | EntryDirty))
+			queueWriteBack(i, _pageTable->entry[i] & EntryFrameMask);
+
+	for (int i = 0; CompressedSwap && i < PagesAmount; i++)
+		if (_pool->data[i] != NULL && _pool->dirty[i]) {
+			Page page;
+			decompressPage(_pool->data[i], _pool->size[i], (unsigned char*)page.PageContent);
+			queuePageWriteBack(i, &page);
+			_pool->dirty[i] = 0;
+		}
+	flushWriteBuffer();
 }
 
 /**
  * 	Initialization/Finalization methods
  */
-// Initializing the Memory Manager
-void initialize(char * inputfile)
+// Allocating a structure on its own cache lines
+void *allocateAligned(size_t size)
+{
+	void *pointer = NULL;
+	if (posix_memalign(&pointer, CacheLineSize, size) != 0)
+		return NULL;
+	return pointer;
+}
+
+// Creating a Memory Manager (NULL when the Backing Store can't be copied)
+MemoryManager *memoryManagerCreate(const char *backingStoreFile, const char *backingStoreCopyFile)
 {
-	backingStore = fopen(backingStore_default, "r");
-	addresses = fopen(inputfile, "r");
-    result = fopen(result_default, "w");
-    
-    _statistics = (Statistics*)malloc(sizeof(Statistics));
-	_pageTable = (PageTable*)malloc(sizeof(PageTable));
-	_memory = (Memory*)malloc(sizeof(Memory));
+	FILE *backingStore = MetadataOnly ? NULL : copyBackingStore(backingStoreFile, backingStoreCopyFile);
+	if (!MetadataOnly && backingStore == NULL)
+		return NULL;
+	_context = (MemoryManager*)calloc(1, sizeof(MemoryManager));
+	_backingStore = backingStore;
+	pthread_mutex_init(&_mutex, NULL);
+
+	_statistics = (Statistics*)malloc(sizeof(Statistics));
+	_pageTable = (PageTable*)allocateAligned(sizeof(PageTable));
+	_memory = (Memory*)allocateAligned(sizeof(Memory));
 	_page = (Page*)malloc(sizeof(Page));
-	_TLB = (TLB*)malloc(sizeof(TLB));
+	_TLB = (TLB*)allocateAligned(sizeof(TLB));
+	_writeBuffer = (WriteBuffer*)malloc(sizeof(WriteBuffer));
+	_writeBuffer->count = 0;
+	_prefetcher = (Prefetcher*)malloc(sizeof(Prefetcher));
+	_prefetcher->lastFaultPage = _prefetcher->windowStart = -1;
+	_prefetcher->lastStride = _prefetcher->windowSize = _prefetcher->windowMarker = 0;
+	_prefetcher->lastMissPage = -1;
+	_prefetcher->lastMissDistance = 0;
+	memset(_prefetcher->missDistance, 0, sizeof(_prefetcher->missDistance));
+	memset(_prefetcher->nextDistance, 0, sizeof(_prefetcher->nextDistance));
+	_walkCache = (WalkCache*)calloc(1, sizeof(WalkCache));
+	memset(_walkCache->prefix, -1, sizeof(_walkCache->prefix));
+	_storage = (Storage*)calloc(1, sizeof(Storage));
+	_pool = (CompressedPool*)calloc(1, sizeof(CompressedPool));
+	_pool->oldest = _pool->newest = -1;
+	_numa = (NUMA*)calloc(1, sizeof(NUMA));
+#if Instrumentation
+	_profile = (StageProfile*)calloc(StagesAmount, sizeof(StageProfile));
+#endif
 	
 	for (int i = 0; i < PagesAmount; i++) 
-		_pageTable->frameNumber[i] = -1;
+		_pageTable->entry[i] = 0;
 	
 	for (int i = 0; i < TLBEntriesAmount; i++)
 		_TLB->frameNumber[i] = _TLB->pageNumber[i] = _TLB->FIFO[i] = -1;
+	memset(_TLB->prefetched, 0, sizeof(_TLB->prefetched));
 		
-	for (int i = 0; i < FramesAmount; i++) {
-		_memory->available[i] = 1;
-		_pageTable->FIFO[i] = -1;
-	}
+	for (int i = 0; i < FramesAmount; i++)
+		_memory->prefetched[i] = 0;
+	for (int i = 0; i < PagesAmount; i++)
+		_pageTable->older[i] = _pageTable->newer[i] = -1;
+	_pageTable->oldest = _pageTable->newest = -1;
 		
+	// Every frame starts available
+	memset(_memory->availableBits, 0, sizeof(_memory->availableBits));
+	memset(_memory->summaryBits, 0, sizeof(_memory->summaryBits));
+	_memory->availableFrames = 0;
+	for (int i = 0; i < FramesAmount; i++)
+		releaseFrame(i);
+
 	_statistics->TranslatedAddressesCounter = 0;
 	_statistics->PageFaultsCounter = 0;
 	_statistics->TLBHitsCounter = 0;
+	_statistics->WritesCounter = 0;
+	_statistics->DirtyEvictionsCounter = 0;
+	_statistics->CoalescedWriteBacksCounter = 0;
+	_statistics->BackingStoreWritesCounter = 0;
+	_statistics->PrefetchedPagesCounter = 0;
+	_statistics->PrefetchReadsCounter = 0;
+	_statistics->UsefulPrefetchesCounter = 0;
+	_statistics->WastedPrefetchesCounter = 0;
+	_statistics->EvictionsCounter = 0;
+	_statistics->DeviceRequestsCounter = 0;
+	_statistics->SimulatedTime = 0;
+	_statistics->FaultStallTime = 0;
+	_statistics->PoolStoresCounter = 0;
+	_statistics->PoolRejectedCounter = 0;
+	_statistics->PoolHitsCounter = 0;
+	_statistics->PoolWriteBacksCounter = 0;
+	_statistics->PoolStoredBytes = 0;
+	_statistics->PoolCompressedBytes = 0;
+	_statistics->LocalAccessesCounter = 0;
+	_statistics->RemoteAccessesCounter = 0;
+	_statistics->MigrationsCounter = 0;
+	_statistics->PageWalksCounter = 0;
+	_statistics->WalkCacheHitsCounter = 0;
+	_statistics->WalkMemoryAccessesCounter = 0;
+	_statistics->TLBPrefetchesCounter = 0;
+	_statistics->UsefulTLBPrefetchesCounter = 0;
+	_statistics->ReferencesCounter = 0;
+
+	if (Profiler)
+		_heatmap = (Heatmap*)calloc(1, sizeof(Heatmap));
+
+	// Time series of the windows (the file is opened on the first one)
+	_lastSnapshot = *_statistics;
+	_snapshotsCounter = 0;
+	return _context;
 }
 
-// Finalizing the Memory Manager
-void finalize()
+// Destroying a Memory Manager
+void memoryManagerDestroy(MemoryManager *manager)
 {
-	statisticsLog();
-	fclose(backingStore);
-	fclose(addresses);
-    fclose(result);
-    
+	_context = manager;
+	if (Profiler) {
+		profileLog();
+		free(_heatmap);
+	}
+
+	// Last (partial) window
+	if (SnapshotWindow > 0) {
+		snapshotLog();
+		if (_timeseries)
+			fclose(_timeseries);
+	}
+	if (_backingStore)
+		fclose(_backingStore);
+	pthread_mutex_destroy(&_mutex);
+
+    free(_statistics);
     free(_pageTable);
     free(_memory);
     free(_page);
     free(_TLB);
+    free(_writeBuffer);
+    free(_prefetcher);
+    free(_walkCache);
+    free(_storage);
+    for (int i = 0; i < PagesAmount; i++)
+        free(_pool->data[i]);
+    free(_pool);
+    free(_numa);
+#if Instrumentation
+    free(_profile);
+#endif
+    free(manager);
+    _context = NULL;
 }
 
 /**
@@ -170,19 +1346,22 @@ void finalize()
 int findPageOnPageTable(int pageNumber)
 {
 	//Return -1 if page is not present (Page Fault)
-	return _pageTable->frameNumber[pageNumber];
+	unsigned int entry = _pageTable->entry[pageNumber];
+	return (entry & EntryValid) ? (int)(entry & EntryFrameMask) : -1;
 }
 
 void *thread_findOnPageTable(void *arg) 
 {
 	ptr_thread_arg targ = (ptr_thread_arg)arg;
+	_context = targ->context;
 	
-	if (_pageTable->frameNumber[targ->pageNumber] != -1) {
+	int frameNumber = findPageOnPageTable(targ->pageNumber);
+	if (frameNumber != -1) {
 		// FrameNumber found. Mutex to prevent errors
-		pthread_mutex_lock(&mutex);
-		if (pageOnTLB == 0) 
-			targ->frameNumber = _pageTable->frameNumber[targ->pageNumber];
-		pthread_mutex_unlock(&mutex);
+		pthread_mutex_lock(&_mutex);
+		if (_pageOnTLB == 0) 
+			targ->frameNumber = frameNumber;
+		pthread_mutex_unlock(&_mutex);
 		return NULL;
 	}
 	
@@ -193,7 +1372,7 @@ void *thread_findOnPageTable(void *arg)
 // Setting Used Page on Page Table
 void setPageOnPageTable(int pageNumber, int frameNumber)
 {
-	_pageTable->frameNumber[pageNumber] = frameNumber;
+	_pageTable->entry[pageNumber] = (_pageTable->entry[pageNumber] & EntryDirty) | EntryValid | frameNumber;
 }
 
 /**
@@ -234,12 +1413,31 @@ int updateTLBFIFO()
 	return slot;
 }
 
+// Counting the first hit on a prefetched translation (a TLB miss eliminated)
+static inline void noteTLBPrefetchUse(int slot)
+{
+	if (TLBPrefetchPolicy != TLBPrefetchNone && _TLB->prefetched[slot]) {
+		_TLB->prefetched[slot] = 0;
+		_statistics->UsefulTLBPrefetchesCounter++;
+	}
+}
+
+// Slot of a page on TLB (-1 when absent), without counting a hit
+int findSlotOnTLB(int pageNumber)
+{
+	for (int i = 0; i < TLBEntriesAmount; i++)
+		if (_TLB->pageNumber[i] == pageNumber)
+			return i;
+	return -1;
+}
+
 // Finding Requested Page on TLB
 int findPageOnTLB(int pageNumber)
 {
 	for (int i = 0; i < TLBEntriesAmount; i++) {
 		if (_TLB->pageNumber[i] == pageNumber) {
 			_statistics->TLBHitsCounter++;
+			noteTLBPrefetchUse(i);
 			//Requested Page is found on TLB
 			return _TLB->frameNumber[i];
 		}
@@ -252,84 +1450,153 @@ int findPageOnTLB(int pageNumber)
 void *thread_findOnTLB(void *arg) 
 {
 	ptr_thread_arg targ = (ptr_thread_arg)arg;
+	_context = targ->context;
 
 	for (int i = 0; i < TLBEntriesAmount; i++)
 		if (_TLB->pageNumber[i] == targ->pageNumber) 
 		{
-			// FrameNumber found. Mutex to prevent errors
-			pthread_mutex_lock(&mutex);
+			// FrameNumber found. Mutex to prevent errors (the hit is counted
+			// under it too)
+			pthread_mutex_lock(&_mutex);
 			targ->frameNumber = _TLB->frameNumber[i];
-			pageOnTLB = 1;
-			pthread_mutex_unlock(&mutex);
-			
+			_pageOnTLB = 1;
 			_statistics->TLBHitsCounter++;
-			
+			noteTLBPrefetchUse(i);
+			pthread_mutex_unlock(&_mutex);
 			return NULL;
 		}
 	
-	// Requested Page not found on TLB.
-	pageOnTLB = 0;
+	// Requested Page not found on TLB (_pageOnTLB stays 0).
 	return NULL;
 }
 
-// Setting Used Page on TLB
-void setPageOnTLB(int pageNumber, int frameNumber)
+// Setting Used Page on TLB (returns its slot)
+int setPageOnTLB(int pageNumber, int frameNumber)
 {
 	int newTLBindex = updateTLBFIFO();
 
 	_TLB->frameNumber[newTLBindex] = frameNumber;
 	_TLB->pageNumber[newTLBindex] = pageNumber;
+	_TLB->prefetched[newTLBindex] = 0;
+	_pageTable->entry[pageNumber] |= EntryReferenced;
+	return newTLBindex;
 }
-/**
- * 	Managing Memory methods
- */
 
-// Find Oldest Frame on memory (first element on FIFO)
-int findOldestFrameOnMemory(int pageNumber)
+// Invalidating an evicted Page on TLB
+void invalidatePageOnTLB(int pageNumber)
 {
-	//The oldest page on the queue
-	int switchedpage = _pageTable->FIFO[0];
+	for (int i = 0; i < TLBEntriesAmount; i++)
+		if (_TLB->pageNumber[i] == pageNumber) {
+			_TLB->frameNumber[i] = _TLB->pageNumber[i] = -1;
+		}
+}
+/**
+ * 	Managing Memory methods
+ */
 
-	//Sets the switched page as unavailable
-	int slot = _pageTable->frameNumber[switchedpage];
-	_pageTable->frameNumber[switchedpage] = -1;
+// Unlinking a page from the FIFO
+void unlinkPageOnFIFO(int pageNumber)
+{
+	if (_pageTable->older[pageNumber] != -1)
+		_pageTable->newer[_pageTable->older[pageNumber]] = _pageTable->newer[pageNumber];
+	else
+		_pageTable->oldest = _pageTable->newer[pageNumber];
+	if (_pageTable->newer[pageNumber] != -1)
+		_pageTable->older[_pageTable->newer[pageNumber]] = _pageTable->older[pageNumber];
+	else
+		_pageTable->newest = _pageTable->older[pageNumber];
+	_pageTable->older[pageNumber] = _pageTable->newer[pageNumber] = -1;
+}
 
-	//Updates the 
-	for (int i = 0; i < FramesAmount - 1; i++) {
-		_pageTable->FIFO[i] = _pageTable->FIFO[i+1];
-	}
+// Linking a page as the newest of the FIFO
+void linkNewestPageOnFIFO(int pageNumber)
+{
+	_pageTable->older[pageNumber] = _pageTable->newest;
+	_pageTable->newer[pageNumber] = -1;
+	if (_pageTable->newest != -1)
+		_pageTable->newer[_pageTable->newest] = pageNumber;
+	else
+		_pageTable->oldest = pageNumber;
+	_pageTable->newest = pageNumber;
+}
 
-	_pageTable->FIFO[FramesAmount-1] = pageNumber;
-	return slot;
+// Linking a page as the oldest of the FIFO
+void linkOldestPageOnFIFO(int pageNumber)
+{
+	_pageTable->newer[pageNumber] = _pageTable->oldest;
+	_pageTable->older[pageNumber] = -1;
+	if (_pageTable->oldest != -1)
+		_pageTable->older[_pageTable->oldest] = pageNumber;
+	else
+		_pageTable->newest = pageNumber;
+	_pageTable->oldest = pageNumber;
 }
 
+// Putting a page on the FIFO position of another one
+void replacePageOnFIFO(int pageNumber, int newPage)
+{
+	int older = _pageTable->older[pageNumber], newer = _pageTable->newer[pageNumber];
+	_pageTable->older[newPage] = older;
+	_pageTable->newer[newPage] = newer;
+	if (older != -1)	_pageTable->newer[older] = newPage;
+	else				_pageTable->oldest = newPage;
+	if (newer != -1)	_pageTable->older[newer] = newPage;
+	else				_pageTable->newest = newPage;
+	_pageTable->older[pageNumber] = _pageTable->newer[pageNumber] = -1;
+}
+
+// Find Victim on FIFO (oldest page, or oldest clean page when preferred)
+int findVictimOnFIFO()
+{
+	int pageNumber = _pageTable->oldest;
+	if (PreferCleanVictims)
+		for (int i = 0; i < CleanVictimWindow && pageNumber != -1; i++, pageNumber = _pageTable->newer[pageNumber])
+			if (!(_pageTable->entry[pageNumber] & EntryDirty))
+				return pageNumber;
+	return _pageTable->oldest;
+}
 
-//Updates values of Page Table FIFO
-void updatePageTableFIFO(int pageNumber) {
+// Evicting a resident page, returning the frame it used
+int evictPageOnMemory(int pageNumber)
+{
+	//Sets the switched page as unavailable, once written back if dirty
+	int slot = _pageTable->entry[pageNumber] & EntryFrameMask;
+	writeBackPage(pageNumber, slot);
+	_pageTable->entry[pageNumber] = 0;
+	_numa->remoteAccesses[pageNumber] = 0;
+	_statistics->EvictionsCounter++;
+	invalidatePageOnTLB(pageNumber);
 
-	for (int i = 0; i < FramesAmount - 1; i++) {
-		_pageTable->FIFO[i] = _pageTable->FIFO[i+1];
+	// Prefetched page evicted before ever being used
+	if (_memory->prefetched[slot]) {
+		_memory->prefetched[slot] = 0;
+		_statistics->WastedPrefetchesCounter++;
 	}
+	return slot;
+}
+
+// Find Oldest Frame on memory (first element on FIFO)
+int findOldestFrameOnMemory(int pageNumber)
+{
+	//The oldest page on the queue
+	int switchedpage = findVictimOnFIFO();
+	int slot = evictPageOnMemory(switchedpage);
 
 	//Puts the most recent page as the last of queue
-	_pageTable->FIFO[FramesAmount-1] = pageNumber;
+	unlinkPageOnFIFO(switchedpage);
+	linkNewestPageOnFIFO(pageNumber);
+	return slot;
 }
 
 // Find Available Frame on memory
 int findAvailableFrameOnMemory(int pageNumber)
 {
-	for (int i = 0; i < FramesAmount; i++) {
-		if (_memory->available[i] == 1) {
-			_memory->available[i] = 0;
-			updatePageTableFIFO(pageNumber);
+	int frameNumber = takePlacedFrame(pageNumber);
 
-			//There is available memory
-			return i;
-		}
-	}
-
-	//There is not available memory
-	return -1;
+	//There is available memory
+	if (frameNumber != -1)
+		linkNewestPageOnFIFO(pageNumber);
+	return frameNumber;
 }
 
 // Find Frame on memory
@@ -343,6 +1610,55 @@ int findFrameOnMemory(int pageNumber)
 	return chosenFrame;
 }
 
+// Find Frames for prefetched pages: free frames, or else the oldest ones.
+// Prefetched pages take the oldest FIFO positions (lowest priority)
+int findPrefetchFramesOnMemory(int *pages, int *frames, int amount)
+{
+	int freeFrames = countAvailableFrames();
+
+	// Free frames go right before the oldest resident page
+	if (freeFrames > 0) {
+		if (amount > freeFrames)
+			amount = freeFrames;
+		for (int i = 0; i < amount; i++) {
+			frames[i] = takePlacedFrame(pages[i]);
+			linkOldestPageOnFIFO(pages[i]);
+		}
+		return amount;
+	}
+
+	// Memory full: replace in place the oldest pages that are not waiting
+	// prefetches themselves (never the newest page)
+	int taken = 0;
+	for (int pageNumber = _pageTable->oldest; taken < amount && pageNumber != _pageTable->newest; ) {
+		int newer = _pageTable->newer[pageNumber];
+		if (!_memory->prefetched[_pageTable->entry[pageNumber] & EntryFrameMask]) {
+			frames[taken] = evictPageOnMemory(pageNumber);
+			replacePageOnFIFO(pageNumber, pages[taken++]);
+		}
+		pageNumber = newer;
+	}
+	return taken;
+}
+
+// Promoting a used prefetched page to the newest FIFO position
+void promotePageOnMemory(int pageNumber)
+{
+	unlinkPageOnFIFO(pageNumber);
+	linkNewestPageOnFIFO(pageNumber);
+}
+
+// Moving a resident page to an available frame, keeping its FIFO position
+// (its TLB entry is shot down)
+void movePageOnMemory(int pageNumber, int frameNumber, int newFrame)
+{
+	if (!MetadataOnly)
+		_memory->frame[newFrame] = _memory->frame[frameNumber];
+	setPageOnPageTable(pageNumber, newFrame);
+	invalidatePageOnTLB(pageNumber);
+	releaseFrame(frameNumber);
+}
+
 /**
  *  Managing Backing Store methods
  */
@@ -350,8 +1666,293 @@ int findFrameOnMemory(int pageNumber)
 void getBackingStorePage(int pageNumber, int frameNumber)
 {
 	_statistics->PageFaultsCounter++;
-	fseek(backingStore, pageNumber*FrameBytesSize, SEEK_SET);
-	fread(_memory->frame[frameNumber].PageContent, FrameBytesSize, 1, backingStore);
+	if (Profiler)
+		_heatmap->faults[pageNumber]++;
+
+	// Page kept compressed on the pool: no Backing Store read
+	if (CompressedSwap && loadFromPool(pageNumber, frameNumber)) {
+		_statistics->PoolHitsCounter++;
+		return;
+	}
+
+	// Page still waiting to be written back: take it from the buffer
+	int index = findPageOnWriteBuffer(pageNumber);
+	if (index != -1) {
+		if (!MetadataOnly)
+			_memory->frame[frameNumber] = _writeBuffer->page[index];
+		return;
+	}
+
+	if (!MetadataOnly) {
+		fseek(_backingStore, pageNumber*FrameBytesSize, SEEK_SET);
+		fread(_memory->frame[frameNumber].PageContent, FrameBytesSize, 1, _backingStore);
+	}
+	stallUntil(scheduleRequest(pageNumber, 1, 0));
+}
+
+// Storing a byte on memory (the page becomes dirty)
+void writeOnMemory(int pageNumber, int frameNumber, int offset, int value)
+{
+	if (!MetadataOnly)
+		_memory->frame[frameNumber].PageContent[offset] = value;
+	_pageTable->entry[pageNumber] |= EntryDirty;
+	_statistics->WritesCounter++;
+}
+
+/**
+ *  Prefetching methods
+ */
+// Loading a run of contiguous prefetched pages with a single read
+void loadPrefetchRun(int firstPage, int count, int *frames)
+{
+	Page run[MetadataOnly ? 1 : PrefetchMaxWindow];
+
+	if (!MetadataOnly) {
+		fseek(_backingStore, firstPage*FrameBytesSize, SEEK_SET);
+		fread(run, FrameBytesSize, count, _backingStore);
+	}
+	_statistics->PrefetchReadsCounter++;
+	unsigned long long completion = scheduleRequest(firstPage, count, 0);
+
+	// Pooled pages and pages waiting to be written back are newer than the backing store
+	for (int i = 0; i < count; i++) {
+		_storage->readyTime[frames[i]] = completion;
+		if (MetadataOnly || (CompressedSwap && loadFromPool(firstPage + i, frames[i])))
+			continue;
+		int index = findPageOnWriteBuffer(firstPage + i);
+		_memory->frame[frames[i]] = index != -1 ? _writeBuffer->page[index] : run[i];
+	}
+}
+
+// Prefetching up to count non resident pages, stride apart from firstPage
+void prefetchPages(int firstPage, int stride, int count)
+{
+	int pages[PrefetchMaxWindow], frames[PrefetchMaxWindow];
+	int amount = 0;
+
+	if (count > PrefetchMaxWindow)
+		count = PrefetchMaxWindow;
+	for (int i = 0; i < count; i++) {
+		int pageNumber = firstPage + i*stride;
+		if (pageNumber < 0 || pageNumber >= PagesAmount)
+			break;
+		if (findPageOnPageTable(pageNumber) == -1)
+			pages[amount++] = pageNumber;
+	}
+
+	amount = findPrefetchFramesOnMemory(pages, frames, amount);
+
+	// One read for each run of contiguous pages
+	for (int start = 0, end; start < amount; start = end) {
+		end = start + 1;
+		while (end < amount && pages[end] == pages[end-1] + 1)
+			end++;
+		loadPrefetchRun(pages[start], end - start, &frames[start]);
+	}
+
+	for (int i = 0; i < amount; i++) {
+		setPageOnPageTable(pages[i], frames[i]);
+		_memory->prefetched[frames[i]] = 1;
+		_statistics->PrefetchedPagesCounter++;
+	}
+}
+
+// Predicting the next pages after a page fault
+void prefetchOnFault(int pageNumber)
+{
+	// Next N pages
+	if (PrefetchPolicy == PrefetchNextN)
+		prefetchPages(pageNumber + 1, 1, PrefetchDegree);
+
+	// Same stride between the last three faults
+	else if (PrefetchPolicy == PrefetchStride) {
+		int stride = pageNumber - _prefetcher->lastFaultPage;
+		if (stride != 0 && stride == _prefetcher->lastStride)
+			prefetchPages(pageNumber + stride, stride, PrefetchDegree);
+		_prefetcher->lastStride = stride;
+		_prefetcher->lastFaultPage = pageNumber;
+	}
+
+	// Readahead: a fault right after the window means a sequential stream, and
+	// one right after the last fault opens a window. Other faults are random
+	// misses, read as they are
+	else if (PrefetchPolicy == PrefetchReadahead) {
+		int lastFaultPage = _prefetcher->lastFaultPage;
+		_prefetcher->lastFaultPage = pageNumber;
+		if (_prefetcher->windowSize > 0 && pageNumber == _prefetcher->windowStart + _prefetcher->windowSize)
+			_prefetcher->windowSize *= 2;
+		else if (pageNumber == lastFaultPage + 1)
+			_prefetcher->windowSize = PrefetchDegree;
+		else {
+			_prefetcher->windowSize = 0;
+			_prefetcher->windowMarker = -1;
+			return;
+		}
+		if (_prefetcher->windowSize > PrefetchMaxWindow)
+			_prefetcher->windowSize = PrefetchMaxWindow;
+
+		_prefetcher->windowStart = pageNumber + 1;
+		_prefetcher->windowMarker = _prefetcher->windowStart + _prefetcher->windowSize/2;
+		prefetchPages(_prefetcher->windowStart, 1, _prefetcher->windowSize);
+	}
+}
+
+// Counting the first use of a prefetched page
+void notePrefetchedUse(int pageNumber, int frameNumber)
+{
+	if (!_memory->prefetched[frameNumber])
+		return;
+
+	_memory->prefetched[frameNumber] = 0;
+	_statistics->UsefulPrefetchesCounter++;
+	stallUntil(_storage->readyTime[frameNumber]);
+	promotePageOnMemory(pageNumber);
+
+	// Readahead: the stream reached the marker, read the next window ahead of it
+	if (PrefetchPolicy == PrefetchReadahead && pageNumber == _prefetcher->windowMarker) {
+		_prefetcher->windowStart += _prefetcher->windowSize;
+		_prefetcher->windowSize *= 2;
+		if (_prefetcher->windowSize > PrefetchMaxWindow)
+			_prefetcher->windowSize = PrefetchMaxWindow;
+
+		_prefetcher->windowMarker = _prefetcher->windowStart + _prefetcher->windowSize/2;
+		prefetchPages(_prefetcher->windowStart, 1, _prefetcher->windowSize);
+	}
+}
+
+/**
+ * 	Page Walk methods
+ */
+// Walking the Page Table levels down to the page entry: the deepest walk
+// cache hit skips the levels above it, and the levels walked fill their
+// caches. Returns the walk latency
+unsigned long long walkPageTable(int pageNumber)
+{
+	if (WalkLevels == 1)
+		return MemoryLatency;
+
+	int prefix[WalkLevels], skipped = 0;
+	for (int level = 0; level < WalkLevels - 1; level++) {
+		prefix[level] = pageNumber >> (LevelBits*(WalkLevels - 1 - level));
+		for (int i = 0; i < WalkCacheEntries; i++)
+			if (_walkCache->prefix[level][i] == prefix[level]) {
+				_walkCache->hits[level]++;
+				skipped = level + 1;
+				break;
+			}
+	}
+	for (int level = skipped; WalkCacheEntries > 0 && level < WalkLevels - 1; level++) {
+		_walkCache->prefix[level][_walkCache->next[level]] = prefix[level];
+		if (++_walkCache->next[level] == WalkCacheEntries)
+			_walkCache->next[level] = 0;
+	}
+
+	_statistics->PageWalksCounter++;
+	_statistics->WalkMemoryAccessesCounter += WalkLevels - skipped;
+	if (skipped > 0)
+		_statistics->WalkCacheHitsCounter++;
+	return (unsigned long long)(WalkLevels - skipped)*MemoryLatency;
+}
+
+/**
+ * 	TLB Prefetching methods
+ */
+// Recording that a TLB miss distance followed another one
+void recordMissDistance(int distance, int nextDistance)
+{
+	int slot = distance & (DistanceTableEntries - 1);
+	int *next = _prefetcher->nextDistance[slot];
+	if (_prefetcher->missDistance[slot] != distance) {
+		_prefetcher->missDistance[slot] = distance;
+		memset(next, 0, sizeof(_prefetcher->nextDistance[slot]));
+	}
+
+	// Newest first, without repeats
+	int i = 0;
+	while (i < TLBPrefetchDegree - 1 && next[i] != nextDistance)
+		i++;
+	for (; i > 0; i--)
+		next[i] = next[i-1];
+	next[0] = nextDistance;
+}
+
+// Predicting the pages translated after a TLB miss (returns how many)
+int predictTranslations(int pageNumber, int *pages)
+{
+	int amount = 0;
+
+	// The pages right after the miss
+	if (TLBPrefetchPolicy == TLBPrefetchSequential)
+		for (int i = 1; i <= TLBPrefetchDegree; i++)
+			pages[amount++] = pageNumber + i;
+
+	// Distance: the distances that followed this miss distance before
+	else if (TLBPrefetchPolicy == TLBPrefetchDistance && _prefetcher->lastMissPage != -1) {
+		int distance = pageNumber - _prefetcher->lastMissPage;
+		if (_prefetcher->lastMissDistance != 0)
+			recordMissDistance(_prefetcher->lastMissDistance, distance);
+
+		int slot = distance & (DistanceTableEntries - 1);
+		if (distance != 0 && _prefetcher->missDistance[slot] == distance)
+			for (int i = 0; i < TLBPrefetchDegree; i++)
+				if (_prefetcher->nextDistance[slot][i] != 0)
+					pages[amount++] = pageNumber + _prefetcher->nextDistance[slot][i];
+		_prefetcher->lastMissDistance = distance;
+	}
+	_prefetcher->lastMissPage = pageNumber;
+	return amount;
+}
+
+// Inserting the predicted translations of resident pages on TLB (a TLB
+// prefetch never faults, and its walk is off the critical path)
+void prefetchTranslations(int pageNumber)
+{
+	int pages[TLBPrefetchDegree];
+	int amount = predictTranslations(pageNumber, pages);
+
+	for (int i = 0; i < amount; i++) {
+		if (pages[i] < 0 || pages[i] >= PagesAmount || findSlotOnTLB(pages[i]) != -1)
+			continue;
+		int frameNumber = findPageOnPageTable(pages[i]);
+		if (frameNumber == -1)
+			continue;
+		_TLB->prefetched[setPageOnTLB(pages[i], frameNumber)] = 1;
+		_statistics->TLBPrefetchesCounter++;
+	}
+}
+
+/**
+ * 	NUMA methods
+ */
+// Accessing the data of a page from the node of the running CPU. A page
+// accessed remotely MigrationThreshold times moves to that node when it has
+// an available frame. Returns the frame holding the page afterwards
+int accessPageOnNode(int pageNumber, int frameNumber)
+{
+	if (frameNode(frameNumber) == _numa->node) {
+		_statistics->LocalAccessesCounter++;
+		advanceClock(MemoryLatency);
+		return frameNumber;
+	}
+	_statistics->RemoteAccessesCounter++;
+	advanceClock(RemoteMemoryLatency);
+
+#if MigrationThreshold > 0
+	if (++_numa->remoteAccesses[pageNumber] < MigrationThreshold)
+		return frameNumber;
+	int newFrame = takeAvailableFrameOnNode(_numa->node);
+	if (newFrame == -1)
+		return frameNumber;
+
+	movePageOnMemory(pageNumber, frameNumber, newFrame);
+	_numa->remoteAccesses[pageNumber] = 0;
+	_statistics->MigrationsCounter++;
+	advanceClock(MigrationLatency);
+	return newFrame;
+#else
+	(void)pageNumber;		// Pages never migrate
+	return frameNumber;
+#endif
 }
 
 /**
@@ -393,27 +1994,40 @@ int findFrameNumberAssynchronous(int pageNumber)
 	thread_arg arguments;
 	arguments.pageNumber = pageNumber;
 	arguments.frameNumber = -1;
-	pageOnTLB = 0;
+	arguments.context = _context;
+	_pageOnTLB = 0;
 	
-	pthread_mutex_init(&mutex, NULL);
-	pthread_create(&threads[0], NULL, thread_findOnTLB, &(arguments));
-	pthread_create(&threads[1], NULL, thread_findOnPageTable, &(arguments));
-	pthread_join(threads[0], NULL);
-	pthread_join(threads[1], NULL);
+	StageStart(probe);
+	pthread_create(&_threads[0], NULL, thread_findOnTLB, &(arguments));
+	pthread_create(&_threads[1], NULL, thread_findOnPageTable, &(arguments));
+	pthread_join(_threads[0], NULL);
+	pthread_join(_threads[1], NULL);
+	StageStop(ParallelProbeStage, probe);
 	
 	int frameNumber = arguments.frameNumber;
+	advanceClock(_pageOnTLB ? TLBLatency : walkPageTable(pageNumber));
 	
 	if (frameNumber == -1)
 	{
 		// Load on memory entire page of BACKING_STORE
+		StageStart(victim);
 		frameNumber = findFrameOnMemory(pageNumber);
+		StageStop(VictimStage, victim);
+		StageStart(backingStore);
 		getBackingStorePage(pageNumber, frameNumber);
+		StageStop(BackingStoreStage, backingStore);
 		
 		// Set up accessed page on Page Table
 		setPageOnPageTable(pageNumber, frameNumber);
+
+		// Load the pages predicted to follow
+		prefetchOnFault(pageNumber);
 	}
-	if (pageOnTLB == 0)
+	if (_pageOnTLB == 0) {
 		setPageOnTLB(pageNumber, frameNumber);
+		if (TLBPrefetchPolicy != TLBPrefetchNone)
+			prefetchTranslations(pageNumber);
+	}
 		
 	return frameNumber;
 }
@@ -424,58 +2038,870 @@ int findFrameNumberAssynchronous(int pageNumber)
 int findFrameNumberSynchronous(int pageNumber)
 {
 	// Find frameNumber on TLB
+	StageStart(tlb);
 	int frameNumber = findPageOnTLB(pageNumber);
+	StageStop(TLBStage, tlb);
+	advanceClock(TLBLatency);
 	
 	// If TLB find fails
 	if (frameNumber == -1)
 	{
 		// Find frameNumber on Page Table
+		advanceClock(walkPageTable(pageNumber));
+		StageStart(pageTable);
 		frameNumber = findPageOnPageTable(pageNumber);
+		StageStop(PageTableStage, pageTable);
 		
 		// If Page Fault
 		if (frameNumber == -1)
 		{
 			// Load on memory entire page of BACKING_STORE
+			StageStart(victim);
 			frameNumber = findFrameOnMemory(pageNumber);
+			StageStop(VictimStage, victim);
+			StageStart(backingStore);
 			getBackingStorePage(pageNumber, frameNumber);
+			StageStop(BackingStoreStage, backingStore);
 			
 			// Set up accessed page on Page Table
 			setPageOnPageTable(pageNumber, frameNumber);
+
+			// Load the pages predicted to follow
+			prefetchOnFault(pageNumber);
 		}
-		// Set up accessed page on TLB
+		// Set up accessed page on TLB, and the translations predicted to follow
 		setPageOnTLB(pageNumber, frameNumber);
+		if (TLBPrefetchPolicy != TLBPrefetchNone)
+			prefetchTranslations(pageNumber);
 	}
 	return frameNumber;
 }
 
 /**
- * 	Main Memory Manager
+ * 	Batch Translation
+ */
+// Translating count references in trace order: physicalAddresses and values
+// receive the results. accesses (ReadAccess, WriteAccess or RewriteAccess)
+// and writeValues may be NULL for reads only
+void translateBatch(int count, const int *virtualAddresses, const char *accesses,
+	const int *writeValues, int *physicalAddresses, int *values)
+{
+	int pageNumbers[TranslationBatch], offsets[TranslationBatch];
+
+	for (int base = 0; base < count; base += TranslationBatch) {
+		int amount = count - base < TranslationBatch ? count - base : TranslationBatch;
+		const int *batch = virtualAddresses + base;
+
+		// Page and offset split of the whole batch (vectorized). Only the low
+		// 16 bits of an address are translated, like the other tools do
+		for (int i = 0; i < amount; i++) {
+			pageNumbers[i] = (batch[i] & VirtualAddressMask)/PagesAmount;
+			offsets[i] = batch[i] & (PagesAmount-1);
+		}
+
+		int lastPage = -1, frameNumber = -1;
+		for (int i = 0; i < amount; i++) {
+			int pageNumber = pageNumbers[i];
+			int offset = offsets[i];
+
+			// Prefetch the Page Table entries ahead, then the frame data of resident pages
+			if (BatchPrefetchDistance > 0 && i + 2*BatchPrefetchDistance < amount)
+				__builtin_prefetch(&_pageTable->entry[pageNumbers[i + 2*BatchPrefetchDistance]]);
+			if (BatchPrefetchDistance > 0 && !MetadataOnly && i + BatchPrefetchDistance < amount) {
+				unsigned int entry = _pageTable->entry[pageNumbers[i + BatchPrefetchDistance]];
+				if (entry & EntryValid)
+					__builtin_prefetch(&_memory->frame[entry & EntryFrameMask].PageContent[offsets[i + BatchPrefetchDistance]]);
+			}
+
+			// Find frameNumber (a run on the same page stays on the TLB: one probe per run,
+			// and only its first reference can be the first use of a prefetched page)
+			if (pageNumber == lastPage) {
+				_statistics->TLBHitsCounter++;
+				advanceClock(TLBLatency);
+			}
+			else {
+				frameNumber = findFrameNumberSynchronous(pageNumber);
+				// frameNumber = findFrameNumberAssynchronous(pageNumber);
+				if (PrefetchPolicy != PrefetchNone)
+					notePrefetchedUse(pageNumber, frameNumber);
+			}
+			lastPage = pageNumber;
+			if (Profiler)
+				profilePageAccess(pageNumber);
+
+			// Store on memory
+			char access = accesses ? accesses[base + i] : ReadAccess;
+			if (access == WriteAccess)
+				writeOnMemory(pageNumber, frameNumber, offset, writeValues[base + i]);
+			else if (access == RewriteAccess)
+				writeOnMemory(pageNumber, frameNumber, offset,
+					MetadataOnly ? 0 : _memory->frame[frameNumber].PageContent[offset]);
+
+			// Parse real Address (NUMA: a page migrated by the access left the TLB)
+			if (NUMANodes > 1) {
+				int accessedFrame = frameNumber;
+				frameNumber = accessPageOnNode(pageNumber, frameNumber);
+				if (frameNumber != accessedFrame)
+					lastPage = -1;
+			}
+			else
+				advanceClock(MemoryLatency);
+			values[base + i] = MetadataOnly ? 0 : _memory->frame[frameNumber].PageContent[offset];
+			physicalAddresses[base + i] = frameNumber*PagesAmount + offset;
+			_statistics->TranslatedAddressesCounter++;
+			_statistics->ReferencesCounter++;
+
+			// Statistics of the window ended
+			if (SnapshotWindow > 0 && _statistics->TranslatedAddressesCounter % SnapshotWindow == 0)
+				snapshotLog();
+
+			// Debugging PageAddress and FrameAddress
+			// debugPageAddress(batch[i], pageNumber, offset);
+			// debugFrameAddress(physicalAddresses[base + i], frameNumber, offset);
+		}
+	}
+}
+
+/**
+ * 	Checkpoint methods
+ */
+// Fixed size parts of the state, in checkpoint order. The Backing Store copy
+// and the compressed pool pages follow them
+int checkpointParts(void **data, size_t *sizes, unsigned long long *stateBytes)
+{
+	int count = 0;
+	data[count] = _statistics;			sizes[count++] = sizeof(Statistics);
+	data[count] = _pageTable;			sizes[count++] = sizeof(PageTable);
+	data[count] = _memory;				sizes[count++] = sizeof(Memory);
+	data[count] = _TLB;					sizes[count++] = sizeof(TLB);
+	data[count] = _writeBuffer;			sizes[count++] = sizeof(WriteBuffer);
+	data[count] = _prefetcher;			sizes[count++] = sizeof(Prefetcher);
+	data[count] = _walkCache;			sizes[count++] = sizeof(WalkCache);
+	data[count] = _storage;				sizes[count++] = sizeof(Storage);
+	data[count] = _pool;				sizes[count++] = sizeof(CompressedPool);
+	data[count] = _numa;				sizes[count++] = sizeof(NUMA);
+	data[count] = &_lastSnapshot;		sizes[count++] = sizeof(Statistics);
+	data[count] = &_snapshotsCounter;	sizes[count++] = sizeof(int);
+	data[count] = &_pageOnTLB;			sizes[count++] = sizeof(int);
+	if (Profiler) {
+		data[count] = _heatmap;			sizes[count++] = sizeof(Heatmap);
+	}
+#if Instrumentation
+	data[count] = _profile;				sizes[count++] = StagesAmount*sizeof(StageProfile);
+#endif
+
+	*stateBytes = 0;
+	for (int i = 0; i < count; i++)
+		*stateBytes += sizes[i];
+	return count;
+}
+
+// Saving the whole state on a checkpoint image, written with a single write
+int memoryManagerCheckpoint(MemoryManager *manager, const char *checkpointFile, long long tracePosition)
+{
+	_context = manager;
+	void *data[CheckpointParts];
+	size_t sizes[CheckpointParts];
+	CheckpointHeader header = {CheckpointMagic, CheckpointPolicy, PagesAmount, FrameBytesSize, 0, tracePosition};
+	int parts = checkpointParts(data, sizes, &header.stateBytes);
+
+	size_t bytes = sizeof(CheckpointHeader) + header.stateBytes + BackingStoreBytes + _pool->bytes;
+	char *image = (char*)malloc(bytes);
+	if (image == NULL)
+		return -1;
+	memcpy(image, &header, sizeof(CheckpointHeader));
+	size_t offset = sizeof(CheckpointHeader);
+	for (int i = 0; i < parts; i++) {
+		memcpy(image + offset, data[i], sizes[i]);
+		offset += sizes[i];
+	}
+
+	// Backing Store copy, with every write back done so far
+	if (!MetadataOnly) {
+		fflush(_backingStore);
+		fseek(_backingStore, 0, SEEK_SET);
+		fread(image + offset, FrameBytesSize, PagesAmount, _backingStore);
+	}
+	offset += BackingStoreBytes;
+	for (int i = 0; i < PagesAmount; i++)
+		if (_pool->data[i] != NULL) {
+			memcpy(image + offset, _pool->data[i], _pool->size[i]);
+			offset += _pool->size[i];
+		}
+
+	int file = open(checkpointFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	ssize_t written = 0, count = 1;
+	while (file != -1 && count > 0 && (size_t)written < bytes)
+		if ((count = write(file, image + written, bytes - written)) > 0)
+			written += count;
+	if (file != -1)
+		close(file);
+	free(image);
+	return (size_t)written == bytes ? 0 : -1;
+}
+
+// Creating a Memory Manager from a checkpoint (NULL when it can't be read or
+// was written by a simulator with another layout)
+MemoryManager *memoryManagerRestore(const char *checkpointFile, const char *backingStoreFile,
+	const char *backingStoreCopyFile, long long *tracePosition)
+{
+	int file = open(checkpointFile, O_RDONLY);
+	struct stat status;
+	if (file == -1 || fstat(file, &status) != 0 || (size_t)status.st_size < sizeof(CheckpointHeader)) {
+		if (file != -1)
+			close(file);
+		return NULL;
+	}
+	char *image = (char*)mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (image == MAP_FAILED)
+		return NULL;
+
+	CheckpointHeader header;
+	memcpy(&header, image, sizeof(CheckpointHeader));
+	MemoryManager *manager = NULL;
+	void *data[CheckpointParts];
+	size_t sizes[CheckpointParts];
+	unsigned long long stateBytes;
+
+	if (memcmp(header.magic, CheckpointMagic, sizeof(header.magic)) == 0 &&
+		strncmp(header.policy, CheckpointPolicy, sizeof(header.policy)) == 0 &&
+		header.pagesAmount == PagesAmount && header.frameBytesSize == FrameBytesSize &&
+		(manager = memoryManagerCreate(backingStoreFile, backingStoreCopyFile)) != NULL) {
+		int parts = checkpointParts(data, sizes, &stateBytes);
+
+		if (header.stateBytes != stateBytes ||
+			(size_t)status.st_size < sizeof(CheckpointHeader) + stateBytes + BackingStoreBytes) {
+			memoryManagerDestroy(manager);
+			manager = NULL;
+		}
+		else {
+			size_t offset = sizeof(CheckpointHeader);
+			for (int i = 0; i < parts; i++) {
+				memcpy(data[i], image + offset, sizes[i]);
+				offset += sizes[i];
+			}
+
+			if (!MetadataOnly) {
+				fseek(_backingStore, 0, SEEK_SET);
+				fwrite(image + offset, FrameBytesSize, PagesAmount, _backingStore);
+				fflush(_backingStore);
+			}
+			offset += BackingStoreBytes;
+
+			// Pool pages (the saved pointers only tell which pages were there),
+			// every one inside the file
+			size_t poolBytes = 0;
+			int valid = 1;
+			for (int i = 0; i < PagesAmount; i++)
+				if (_pool->data[i] != NULL) {
+					valid = valid && _pool->size[i] > 0 && _pool->size[i] <= FrameBytesSize;
+					poolBytes += _pool->size[i] > 0 ? _pool->size[i] : 0;
+				}
+			valid = valid && offset + poolBytes <= (size_t)status.st_size;
+			for (int i = 0; i < PagesAmount; i++)
+				if (_pool->data[i] != NULL && valid) {
+					_pool->data[i] = (unsigned char*)malloc(_pool->size[i]);
+					memcpy(_pool->data[i], image + offset, _pool->size[i]);
+					offset += _pool->size[i];
+				}
+				else
+					_pool->data[i] = NULL;
+
+			if (valid)
+				*tracePosition = header.tracePosition;
+			else {
+				memoryManagerDestroy(manager);
+				manager = NULL;
+			}
+		}
+	}
+	munmap(image, status.st_size);
+	return manager;
+}
+
+/**
+ * 	Library methods (libmemmgr.h)
+ */
+// Translating one reference
+int memoryManagerTranslate(MemoryManager *manager, int virtualAddress, int access, int writeValue, int *value)
+{
+	char accessType = access;
+	int physicalAddress, byte;
+
+	_context = manager;
+	translateBatch(1, &virtualAddress, &accessType, &writeValue, &physicalAddress, &byte);
+	if (value)
+		*value = byte;
+	return physicalAddress;
+}
+
+// Translating count references in order
+void memoryManagerTranslateBatch(MemoryManager *manager, int count, const int *virtualAddresses,
+	const char *accesses, const int *writeValues, int *physicalAddresses, int *values)
+{
+	_context = manager;
+	translateBatch(count, virtualAddresses, accesses, writeValues, physicalAddresses, values);
+}
+
+// Copying the statistics so far
+void memoryManagerStatistics(MemoryManager *manager, Statistics *statistics)
+{
+	*statistics = *manager->statistics;
+}
+
+// Writing every dirty resident page on the Backing Store copy
+void memoryManagerSync(MemoryManager *manager)
+{
+	_context = manager;
+	syncBackingStore();
+	if (_backingStore)
+		fflush(_backingStore);
+}
+
+// Starting the statistics over, once the tables are warm. The clock
+// restarts too, so pending device times move back with it
+void memoryManagerResetStatistics(MemoryManager *manager)
+{
+	_context = manager;
+	unsigned long long now = _statistics->SimulatedTime;
+	for (int i = 0; i < _storage->pending; i++)
+		_storage->completion[i] = _storage->completion[i] > now ? _storage->completion[i] - now : 0;
+	for (int i = 0; i < FramesAmount; i++)
+		_storage->readyTime[i] = _storage->readyTime[i] > now ? _storage->readyTime[i] - now : 0;
+
+	long long references = _statistics->ReferencesCounter;
+	memset(_statistics, 0, sizeof(Statistics));
+	memset(&_lastSnapshot, 0, sizeof(Statistics));
+	_statistics->ReferencesCounter = references;
+	memset(_walkCache->hits, 0, sizeof(_walkCache->hits));
+}
+
+// Turning functional warming on or off
+void memoryManagerSetWarming(MemoryManager *manager, int warming)
+{
+	manager->functionalWarming = warming;
+}
+
+// Naming the output files of a context after a prefix
+void memoryManagerSetOutputPrefix(MemoryManager *manager, const char *prefix)
+{
+	snprintf(manager->outputPrefix, OutputPathLength, "%s", prefix ? prefix : "");
+}
+
+// Moving the running CPU to a NUMA node
+void memoryManagerSetNode(MemoryManager *manager, int node)
+{
+	if (node >= 0 && node < NUMANodes)
+		manager->numa->node = node;
+}
+
+// Writing the statistics log
+void memoryManagerLog(MemoryManager *manager, FILE *output)
+{
+	_context = manager;
+	statisticsLog(output);
+}
+
+#ifndef MemoryManager_NoMain
+/**
+ * 	Streaming Input methods
+ */
+// Trace Batch - References parsed by the reader thread
+typedef struct traceBatch {
+	int count;
+	int virtualAddresses[TranslationBatch], writeValues[TranslationBatch];
+	char accesses[TranslationBatch];
+	long long endOffset[TranslationBatch];		// Input bytes up to the end of each reference
+} TraceBatch;
+
+// Trace Ring - Bounded ring of batches between the reader thread and the
+// translator: a full ring blocks the reader, so memory stays constant
+typedef struct traceRing {
+	TraceBatch batch[RingBatches];
+	int head, count;			// Next batch to translate, batches ready
+	int consumed;				// References already taken from the head batch
+	int finished;				// The reader reached the end of the input
+	int failed;					// The input format or an address can't be read
+	int file;
+	long long skip;				// Bytes already translated (restored runs)
+	char block[ReadBlockBytes];
+
+	// Decompression of the input bytes (its first bytes tell the format)
+	int format, binary;
+	char compressed[ReadBlockBytes];
+	int pending;				// Input bytes read to tell the format
+#if TraceGzip
+	z_stream gzip;
+#endif
+#if TraceZstd
+	ZSTD_DCtx *zstd;
+	ZSTD_inBuffer zstdInput;
+#endif
+	pthread_mutex_t mutex;
+	pthread_cond_t notEmpty, notFull;
+	pthread_t reader;
+} TraceRing;
+
+// Handing a filled batch to the translator
+void publishTraceBatch(TraceRing *ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	ring->count++;
+	pthread_cond_signal(&ring->notEmpty);
+	pthread_mutex_unlock(&ring->mutex);
+}
+
+// Waiting for a free batch to fill (the translator is RingBatches behind at most)
+TraceBatch *reserveTraceBatch(TraceRing *ring)
+{
+	pthread_mutex_lock(&ring->mutex);
+	while (ring->count == RingBatches)
+		pthread_cond_wait(&ring->notFull, &ring->mutex);
+	TraceBatch *batch = &ring->batch[(ring->head + ring->count) % RingBatches];
+	pthread_mutex_unlock(&ring->mutex);
+	batch->count = 0;
+	return batch;
+}
+
+// Parsing one line of the trace ("address [R|W [value]]") into the batch
+void parseTraceLine(TraceBatch *batch, char *line, long long endOffset)
+{
+	char access;
+	int index = batch->count++;
+	int fields = parseLine(line, &batch->virtualAddresses[index], &access, &batch->writeValues[index]);
+
+	// Without a value the byte is rewritten as is
+	batch->accesses[index] = ReadAccess;
+	if (fields >= 2 && (access == 'W' || access == 'w'))
+		batch->accesses[index] = fields < 3 ? RewriteAccess : WriteAccess;
+	batch->endOffset[index] = endOffset;
+}
+
+// Telling the input format from its first bytes, kept to be read again.
+// Returns the offset reading starts at (-1 when the trace can't be read)
+long long openTraceSource(TraceRing *ring)
+{
+	const unsigned char gzipMagic[] = {0x1F, 0x8B}, zstdMagic[] = {0x28, 0xB5, 0x2F, 0xFD};
+	ssize_t bytes;
+	while (ring->pending < 4 && (bytes = read(ring->file, ring->compressed + ring->pending, 4 - ring->pending)) > 0)
+		ring->pending += bytes;
+
+	ring->format = PlainTrace;
+	ring->binary = ring->pending == 4 && memcmp(ring->compressed, TraceMagic, 4) == 0;
+	if (ring->pending >= 2 && memcmp(ring->compressed, gzipMagic, 2) == 0)
+		ring->format = GzipTrace;
+	if (ring->pending == 4 && memcmp(ring->compressed, zstdMagic, 4) == 0)
+		ring->format = ZstdTrace;
+
+#if TraceGzip
+	if (ring->format == GzipTrace) {
+		memset(&ring->gzip, 0, sizeof(z_stream));
+		ring->gzip.next_in = (unsigned char*)ring->compressed;
+		ring->gzip.avail_in = ring->pending;
+		return inflateInit2(&ring->gzip, 16 + MAX_WBITS) == Z_OK ? 0 : -1;
+	}
+#endif
+#if TraceZstd
+	if (ring->format == ZstdTrace) {
+		ring->zstd = ZSTD_createDCtx();
+		ring->zstdInput.src = ring->compressed;
+		ring->zstdInput.size = ring->pending;
+		ring->zstdInput.pos = 0;
+		return ring->zstd ? 0 : -1;
+	}
+#endif
+	if (ring->format != PlainTrace) {
+		fprintf(stderr, "%s traces need the simulator built with %s\n",
+			ring->format == GzipTrace ? "gzip" : "zstd", ring->format == GzipTrace ? "zlib" : "libzstd");
+		return -1;
+	}
+
+	// Plain traces seek straight to the references of restored runs
+	if (ring->skip > 0 && lseek(ring->file, ring->skip, SEEK_SET) != -1) {
+		ring->pending = 0;
+		return ring->skip;
+	}
+	return 0;
+}
+
+// Reading decompressed trace bytes (0 at the end of the input). A corrupted
+// stream fails the ring after the bytes decompressed before it
+ssize_t readTraceBytes(TraceRing *ring, char *buffer, size_t size)
+{
+	if (ring->format == PlainTrace) {
+		if (ring->pending == 0)
+			return read(ring->file, buffer, size);
+		size_t bytes = ring->pending;
+		memcpy(buffer, ring->compressed, bytes);
+		ring->pending = 0;
+		return bytes;
+	}
+
+#if TraceGzip
+	// Members follow each other until the input ends
+	if (ring->format == GzipTrace) {
+		z_stream *stream = &ring->gzip;
+		ssize_t bytes = 1;
+		stream->next_out = (unsigned char*)buffer;
+		stream->avail_out = size;
+		while (stream->avail_out == size && bytes > 0) {
+			if (stream->avail_in == 0 && (bytes = read(ring->file, ring->compressed, ReadBlockBytes)) > 0) {
+				stream->next_in = (unsigned char*)ring->compressed;
+				stream->avail_in = bytes;
+			}
+			int status = inflate(stream, Z_NO_FLUSH);
+			if (status == Z_STREAM_END)
+				inflateReset(stream);
+			else if (status != Z_OK && !(status == Z_BUF_ERROR && stream->avail_in == 0)) {
+				fprintf(stderr, "Corrupted gzip trace: %s\n", stream->msg ? stream->msg : "");
+				ring->failed = 1;
+				break;
+			}
+		}
+		return size - stream->avail_out;
+	}
+#endif
+#if TraceZstd
+	if (ring->format == ZstdTrace) {
+		ZSTD_outBuffer output = {buffer, size, 0};
+		ssize_t bytes = 1;
+		while (output.pos == 0 && bytes > 0) {
+			if (ring->zstdInput.pos == ring->zstdInput.size && (bytes = read(ring->file, ring->compressed, ReadBlockBytes)) > 0) {
+				ring->zstdInput.size = bytes;
+				ring->zstdInput.pos = 0;
+			}
+			size_t status = ZSTD_decompressStream(ring->zstd, &output, &ring->zstdInput);
+			if (ZSTD_isError(status)) {
+				fprintf(stderr, "Corrupted zstd trace: %s\n", ZSTD_getErrorName(status));
+				ring->failed = 1;
+				break;
+			}
+		}
+		return output.pos;
+	}
+#endif
+	return 0;
+}
+
+// Parsing one little-endian uint32 address of a binary trace into the batch.
+// Addresses beyond the 16 bit virtual space are rejected (returns 0)
+int parseTraceWord(TraceBatch *batch, unsigned char *word, long long endOffset)
+{
+	unsigned int address = word[0] | word[1] << 8 | word[2] << 16 | (unsigned int)word[3] << 24;
+	if (address > VirtualAddressMask) {
+		fprintf(stderr, "Address %u out of range at byte %lld of the binary trace\n", address, endOffset - 4);
+		return 0;
+	}
+
+	int index = batch->count++;
+	batch->virtualAddresses[index] = address;
+	batch->accesses[index] = ReadAccess;
+	batch->writeValues[index] = 0;
+	batch->endOffset[index] = endOffset;
+	return 1;
+}
+
+// Reader thread: large block reads, decompressed when needed, split into
+// lines (or binary addresses) and parsed in batches
+void *readTrace(void *arg)
+{
+	TraceRing *ring = (TraceRing*)arg;
+	TraceBatch *batch = reserveTraceBatch(ring);
+	char line[MaxStringLength];
+	int length = 0;
+	ssize_t bytes;
+
+	// Restored runs start after the translated references: plain traces seek
+	// there, the others (pipes, compressed traces) skip them while parsing
+	long long offset = openTraceSource(ring);
+	ring->failed = offset == -1;
+
+	while (!ring->failed && (bytes = readTraceBytes(ring, ring->block, ReadBlockBytes)) > 0) {
+		if (offset == 0)
+			ring->binary = bytes >= 4 && memcmp(ring->block, TraceMagic, 4) == 0;
+		for (ssize_t i = 0; i < bytes; i++) {
+			if (++offset <= ring->skip || (ring->binary && offset <= TraceHeaderBytes))
+				continue;
+			if (ring->binary) {
+				line[length++] = ring->block[i];
+				if (length == 4) {
+					length = 0;
+					if (!parseTraceWord(batch, (unsigned char*)line, offset)) {
+						ring->failed = 1;
+						break;
+					}
+				}
+			}
+			else if (ring->block[i] != '\n') {
+				if (length < MaxStringLength - 1)
+					line[length++] = ring->block[i];
+				continue;
+			}
+			else {
+				line[length] = '\0';
+				length = 0;
+				parseTraceLine(batch, line, offset);
+			}
+			if (batch->count == TranslationBatch) {
+				publishTraceBatch(ring);
+				batch = reserveTraceBatch(ring);
+			}
+		}
+	}
+
+	// Last line without a line break
+	if (length > 0 && !ring->binary) {
+		line[length] = '\0';
+		parseTraceLine(batch, line, offset);
+	}
+	if (batch->count > 0)
+		publishTraceBatch(ring);
+#if TraceGzip
+	if (ring->format == GzipTrace)
+		inflateEnd(&ring->gzip);
+#endif
+#if TraceZstd
+	if (ring->format == ZstdTrace)
+		ZSTD_freeDCtx(ring->zstd);
+#endif
+
+	pthread_mutex_lock(&ring->mutex);
+	ring->finished = 1;
+	pthread_cond_signal(&ring->notEmpty);
+	pthread_mutex_unlock(&ring->mutex);
+	return NULL;
+}
+
+// Taking up to amount parsed references (0 once the trace ends). position
+// receives the input bytes up to the last one taken
+int takeReferences(TraceRing *ring, int amount, int *virtualAddresses, char *accesses,
+	int *writeValues, long long *position)
+{
+	pthread_mutex_lock(&ring->mutex);
+	while (ring->count == 0 && !ring->finished)
+		pthread_cond_wait(&ring->notEmpty, &ring->mutex);
+	int ready = ring->count;
+	pthread_mutex_unlock(&ring->mutex);
+	if (ready == 0)
+		return 0;
+
+	TraceBatch *batch = &ring->batch[ring->head];
+	if (amount > batch->count - ring->consumed)
+		amount = batch->count - ring->consumed;
+	memcpy(virtualAddresses, &batch->virtualAddresses[ring->consumed], amount*sizeof(int));
+	memcpy(accesses, &batch->accesses[ring->consumed], amount*sizeof(char));
+	memcpy(writeValues, &batch->writeValues[ring->consumed], amount*sizeof(int));
+	ring->consumed += amount;
+	*position = batch->endOffset[ring->consumed - 1];
+
+	// Head batch done: its slot goes back to the reader
+	if (ring->consumed == batch->count) {
+		pthread_mutex_lock(&ring->mutex);
+		ring->head = (ring->head + 1) % RingBatches;
+		ring->count--;
+		ring->consumed = 0;
+		pthread_cond_signal(&ring->notFull);
+		pthread_mutex_unlock(&ring->mutex);
+	}
+	return amount;
+}
+
+/**
+ * 	Sampled Simulation methods
+ */
+// Sampling - Measured windows, summed for the mean and variance of each metric
+typedef struct sampling {
+	long long period, window;
+	int samples;
+	double sum[SampledMetrics], sumSquares[SampledMetrics];
+	Statistics start;
+} Sampling;
+
+// Closing a measured window: its rates are one more sample
+void closeSample(Sampling *sampling, MemoryManager *manager)
+{
+	Statistics end;
+	memoryManagerStatistics(manager, &end);
+	double references = end.TranslatedAddressesCounter - sampling->start.TranslatedAddressesCounter;
+	double metric[SampledMetrics] = {
+		(end.PageFaultsCounter - sampling->start.PageFaultsCounter)/references,
+		(end.TLBHitsCounter - sampling->start.TLBHitsCounter)/references,
+		(end.SimulatedTime - sampling->start.SimulatedTime)/references};
+
+	for (int i = 0; i < SampledMetrics; i++) {
+		sampling->sum[i] += metric[i];
+		sampling->sumSquares[i] += metric[i]*metric[i];
+	}
+	sampling->samples++;
+}
+
+// Sampled Statistics Log: mean and confidence interval of every metric
+void samplingLog(Sampling *sampling, FILE *result)
+{
+	const char *names[SampledMetrics] = {"Sampled Page Fault Rate", "Sampled TLB Hit Rate",
+		"Sampled Effective Access Time (ns)"};
+	int samples = sampling->samples;
+
+	fprintf(result, "Samples = %d\n", samples);
+	fprintf(result, "Sampled References = %lld\n", samples*sampling->window);
+	for (int i = 0; samples > 0 && i < SampledMetrics - (StorageModel == StorageNone); i++) {
+		double mean = sampling->sum[i]/samples;
+		double variance = samples > 1 ? (sampling->sumSquares[i] - samples*mean*mean)/(samples - 1) : 0;
+		double interval = SamplingConfidence*sqrt(variance > 0 ? variance/samples : 0);
+		fprintf(result, "%s = %.4f +- %.4f\n", names[i], mean, interval);
+	}
+}
+
+/**
+ * 	Main Memory Manager (command line interface over the library)
  */
 int main(int arc, char** argv)
 {
-	if(arc == 1) 	initialize(inputfile_default);
-	else 			initialize(argv[1]);
-	
-    while(fgets(line , MaxStringLength, addresses))
-    {
-		// Read new virtual Address
-        int virtualAddress = atoi(line);
-        int pageNumber =  virtualAddress/PagesAmount;
-        int offset = virtualAddress & (PagesAmount-1);
-        
-        // Find frameNumber
-        int frameNumber = findFrameNumberSynchronous(pageNumber);
-        // int frameNumber = findFrameNumberAssynchronous(pageNumber);
-        
-		// Parse real Address
-		int value = _memory->frame[frameNumber].PageContent[offset];
-		int realAddress = frameNumber*PagesAmount + offset;
-		writeOut(virtualAddress, realAddress, value);
-		
-		// Debuggind PageAddress and FrameAddress
-        // debugPageAddress(virtualAddress, pageNumber, offset);
-        // debugFrameAddress(realAddress, frameNumber, offset);
-    }
-    finalize();
-    return 0;
+	// [-c checkpoint references] [-r checkpoint] [-w references] [-s period window]
+	// [-i references] [-n references] [input, - for stdin]
+	char *inputfile = inputfile_default, *checkpointFile = NULL, *restoreFile = NULL;
+	long long checkpointAt = -1, warmup = 0, progress = 0, nodeSwitch = 0;
+	Sampling sampling = {0};
+	for (int i = 1; i < arc; i++) {
+		if (strcmp(argv[i], "-c") == 0 && i + 2 < arc) {
+			checkpointFile = argv[++i];
+			checkpointAt = atoll(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-r") == 0 && i + 1 < arc)
+			restoreFile = argv[++i];
+		else if (strcmp(argv[i], "-w") == 0 && i + 1 < arc)
+			warmup = atoll(argv[++i]);
+		else if (strcmp(argv[i], "-s") == 0 && i + 2 < arc) {
+			sampling.period = atoll(argv[++i]);
+			sampling.window = atoll(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-i") == 0 && i + 1 < arc)
+			progress = atoll(argv[++i]);
+		else if (strcmp(argv[i], "-n") == 0 && i + 1 < arc)
+			nodeSwitch = atoll(argv[++i]);
+		else
+			inputfile = argv[i];
+	}
+	if (sampling.period > 0 && (sampling.window <= 0 || sampling.window > sampling.period)) {
+		fprintf(stderr, "The sampling window must fit in its period\n");
+		return 1;
+	}
+
+	// Files, pipes and FIFOs are all streamed through the ring
+	static TraceRing ring;
+	ring.file = strcmp(inputfile, "-") == 0 ? STDIN_FILENO : open(inputfile, O_RDONLY);
+	if (ring.file == -1) {
+		fprintf(stderr, "Cannot open %s\n", inputfile);
+		return 1;
+	}
+	long long tracePosition = 0;
+	MemoryManager *manager = restoreFile
+		? memoryManagerRestore(restoreFile, backingStore_default, backingStoreCopy_default, &tracePosition)
+		: memoryManagerCreate(backingStore_default, backingStoreCopy_default);
+	if (manager == NULL) {
+		if (restoreFile)
+			fprintf(stderr, "Cannot restore %s\n", restoreFile);
+		else
+			fprintf(stderr, "Cannot copy %s to %s\n", backingStore_default, backingStoreCopy_default);
+		return 1;
+	}
+	// A restored run goes on from the checkpointed reference
+	ring.skip = tracePosition;
+	pthread_mutex_init(&ring.mutex, NULL);
+	pthread_cond_init(&ring.notEmpty, NULL);
+	pthread_cond_init(&ring.notFull, NULL);
+	pthread_create(&ring.reader, NULL, readTrace, &ring);
+	Statistics statistics;
+	memoryManagerStatistics(manager, &statistics);
+	long long references = statistics.ReferencesCounter;
+
+	FILE *result = fopen(result_default, "w");
+	int virtualAddresses[TranslationBatch], writeValues[TranslationBatch];
+	int physicalAddresses[TranslationBatch], values[TranslationBatch];
+	char accesses[TranslationBatch];
+	int amount, measured = 1;
+
+	do {
+		// Checkpoint once the given reference is reached (batches stop right there)
+		int batch = TranslationBatch;
+		if (checkpointFile && references == checkpointAt &&
+			memoryManagerCheckpoint(manager, checkpointFile, tracePosition) != 0)
+			fprintf(stderr, "Cannot write checkpoint %s\n", checkpointFile);
+		if (checkpointFile && references < checkpointAt && checkpointAt - references < batch)
+			batch = checkpointAt - references;
+
+		// Warm-up prefix: functional warming, then the statistics start over
+		memoryManagerSetWarming(manager, references < warmup);
+		measured = references >= warmup || sampling.period == 0;
+		if (references == warmup && warmup > 0)
+			memoryManagerResetStatistics(manager);
+		if (references < warmup && warmup - references < batch)
+			batch = warmup - references;
+
+		// Sampling period: fast-forward, detailed warming, then the measured window
+		if (sampling.period > 0 && references >= warmup) {
+			long long offset = (references - warmup) % sampling.period;
+			long long measureStart = sampling.period - sampling.window;
+			long long detailStart = measureStart > DetailedWarming ? measureStart - DetailedWarming : 0;
+			if (offset == 0 && references > warmup)
+				closeSample(&sampling, manager);
+			if (offset == measureStart)
+				memoryManagerStatistics(manager, &sampling.start);
+
+			memoryManagerSetWarming(manager, offset < detailStart);
+			measured = offset >= measureStart;
+			long long next = offset < detailStart ? detailStart : offset < measureStart ? measureStart : sampling.period;
+			if (next - offset < batch)
+				batch = next - offset;
+		}
+
+		// NUMA: the trace moves to the next node every nodeSwitch references
+		if (nodeSwitch > 0) {
+			memoryManagerSetNode(manager, references/nodeSwitch % NUMANodes);
+			if (nodeSwitch - references % nodeSwitch < batch)
+				batch = nodeSwitch - references % nodeSwitch;
+		}
+
+		// Take new virtual Addresses and access types, parsed by the reader thread
+		StageStart(parse);
+		amount = takeReferences(&ring, batch, virtualAddresses, accesses, writeValues, &tracePosition);
+		StageStop(ParseStage, parse);
+
+		// Find frameNumbers, store and load values
+		memoryManagerTranslateBatch(manager, amount, virtualAddresses, accesses, writeValues,
+			physicalAddresses, values);
+		references += amount;
+
+		for (int i = 0; measured && i < amount; i++) {
+			StageStart(output);
+			writeOut(result, virtualAddresses[i], physicalAddresses[i], values[i]);
+			StageStop(OutputStage, output);
+		}
+
+		// Incremental statistics of live traces
+		if (progress > 0 && references/progress != (references - amount)/progress) {
+			memoryManagerStatistics(manager, &statistics);
+			fprintf(stderr, "References = %lld Page Faults = %lld Page Fault Rate = %.3f TLB Hit Rate = %.3f\n",
+				references, statistics.PageFaultsCounter,
+				(float)statistics.PageFaultsCounter/statistics.TranslatedAddressesCounter,
+				(float)statistics.TLBHitsCounter/statistics.TranslatedAddressesCounter);
+		}
+	} while (amount > 0);
+	pthread_join(ring.reader, NULL);
+	close(ring.file);
+
+	// A trace that can't be read leaves no statistics
+	if (!ring.failed) {
+		if (checkpointFile && references < checkpointAt)
+			fprintf(stderr, "The trace ends before reference %lld: no checkpoint written\n", checkpointAt);
+		memoryManagerSync(manager);
+		memoryManagerLog(manager, result);
+		if (sampling.period > 0)
+			samplingLog(&sampling, result);
+	}
+	memoryManagerDestroy(manager);
+	fclose(result);
+	return ring.failed;
 }
+#endif
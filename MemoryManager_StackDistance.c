@@ -0,0 +1,151 @@
+/**
+ * CES-33 Final Project
+ *
+ *  Memory Manager Simulator - LRU Stack Distance Analysis
+ *
+ *  Felipe Tuyama de F. Barbosa
+ *	Luiz Angel Rocha Rafael
+ *
+ *	The curves are those of true LRU, where every reference makes its page
+ *	the most recently used. MemoryManager_LRU ages its frames only when a
+ *	page is loaded, so its page faults differ from these.
+ */
+
+/**
+ * 	Memory Manager Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "MemoryManager_Trace.h"
+
+/**
+ * 	Memory Manager Defines
+ */
+// Virtual Memory Pages
+#define PagesAmount			256
+#define FrameBytesSize		256
+
+//Files
+#define inputfile_default 	"addresses.txt"
+#define result_default 		"stackdistance.txt"
+
+/**
+ * 	Memory Manager Structs
+ */
+// Stack Distance Histogram
+typedef struct stackDistance {
+	// distance[d] counts references whose page was the d-th most recently used
+	long long distance[PagesAmount+1];
+	long long coldMisses;
+} StackDistance;
+
+/**
+ * 	Program Global Variables
+ */
+Trace *_trace;
+StackDistance *_stackDistance;
+
+// Fenwick tree over trace positions: 1 marks the last access of some page
+int *_fenwick;
+
+/**
+ * 	Fenwick Tree methods
+ */
+// Adding delta at trace position (1-based)
+void fenwickAdd(long long position, int delta)
+{
+	for (; position <= _trace->length; position += position & -position)
+		_fenwick[position] += delta;
+}
+
+// Counting marks on positions 1..position
+int fenwickSum(long long position)
+{
+	int sum = 0;
+	for (; position > 0; position -= position & -position)
+		sum += _fenwick[position];
+	return sum;
+}
+
+/**
+ * 	Stack Distance methods
+ */
+// Single pass over the trace computing the LRU stack distance of every reference
+void computeStackDistances()
+{
+	long long lastAccess[PagesAmount];
+	for (int i = 0; i < PagesAmount; i++)
+		lastAccess[i] = 0;
+
+	for (long long t = 1; t <= _trace->length; t++) {
+		int pageNumber = (_trace->virtualAddress[t-1] & TraceAddressMask)/FrameBytesSize;
+		long long last = lastAccess[pageNumber];
+
+		if (last == 0)
+			_stackDistance->coldMisses++;
+		else {
+			// Distinct pages touched since the last access, plus the page itself
+			int distance = fenwickSum(t-1) - fenwickSum(last) + 1;
+			_stackDistance->distance[distance]++;
+			fenwickAdd(last, -1);
+		}
+		fenwickAdd(t, 1);
+		lastAccess[pageNumber] = t;
+	}
+}
+
+// Fault and TLB hit curves for every size 1..PagesAmount
+void stackDistanceLog(char *resultfile)
+{
+	FILE *result = fopen(resultfile, "w");
+	long long hits = 0;
+
+	fprintf(result, "Replacement = true LRU (recency updated on every reference)\n");
+	fprintf(result, "Number of Translated Addresses = %lld\n", _trace->length);
+	fprintf(result, "Cold Misses = %lld\n", _stackDistance->coldMisses);
+	fprintf(result, "%6s %11s %15s %8s %12s\n",
+		"Size", "Page Faults", "Page Fault Rate", "TLB Hits", "TLB Hit Rate");
+
+	// A true LRU memory with k frames, or a true LRU TLB with k entries,
+	// hits exactly the references with stack distance <= k
+	for (int k = 1; k <= PagesAmount; k++) {
+		hits += _stackDistance->distance[k];
+		long long pageFaults = _trace->length - hits;
+
+		float pageFaultRate = pageFaults;
+			  pageFaultRate = pageFaultRate/_trace->length;
+		float tlbHitsRate = hits;
+			  tlbHitsRate = tlbHitsRate/_trace->length;
+
+		fprintf(result, "%6d %11lld %15.3f %8lld %12.3f\n",
+			k, pageFaults, pageFaultRate, hits, tlbHitsRate);
+	}
+	fclose(result);
+}
+
+/**
+ * 	Main Stack Distance Analysis
+ */
+int main(int arc, char** argv)
+{
+	if(arc == 1)	_trace = loadTrace(inputfile_default, 0);
+	else 			_trace = loadTrace(argv[1], 0);
+
+	if (_trace->length == 0) {
+		fprintf(stderr, "Empty trace\n");
+		return 1;
+	}
+
+	_stackDistance = (StackDistance*)calloc(1, sizeof(StackDistance));
+	_fenwick = (int*)calloc(_trace->length + 1, sizeof(int));
+
+	computeStackDistances();
+	stackDistanceLog(result_default);
+
+	free(_fenwick);
+	free(_stackDistance);
+	freeTrace(_trace);
+	return 0;
+}
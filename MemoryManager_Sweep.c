@@ -0,0 +1,435 @@
+/**
+ * CES-33 Final Project
+ *
+ *  Memory Manager Simulator - Configuration Sweep
+ *
+ *  Felipe Tuyama de F. Barbosa
+ *	Luiz Angel Rocha Rafael
+ */
+
+/**
+ * 	Memory Manager Includes
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "MemoryManager_Trace.h"
+
+/**
+ * 	Memory Manager Defines
+ */
+// Max Number Definitions
+#define MaxThreads			64
+#define MaxSweepValues		16		// Values of each grid dimension
+#define MaxConfigurations	(MaxSweepValues*MaxSweepValues*PoliciesAmount)
+
+// Virtual Memory Pages
+#define PagesAmount			256
+#define FrameBytesSize		256
+
+// Replacement Policies
+#define FIFOPolicy			0
+#define LRUPolicy			1
+#define PoliciesAmount		2
+
+//Files
+#define inputfile_default 	"addresses.txt"
+#define result_default 		"sweep.txt"
+
+/**
+ * 	Memory Manager Structs
+ */
+// Sweep List - Values of one grid dimension
+typedef struct sweepList {
+	int value[MaxSweepValues];
+	int amount;
+} SweepList;
+
+// Configuration of one simulator instance
+typedef struct configuration {
+	int framesAmount;
+	int TLBEntriesAmount;
+	int policy;
+} Configuration;
+
+// Statistics
+typedef struct statistics {
+	long long TranslatedAddressesCounter;
+	long long PageFaultsCounter;
+	long long TLBHitsCounter;
+} Statistics;
+
+// Simulator - Page Table, TLB and Memory metadata of one instance, replaced
+// like MemoryManager_FIFO and MemoryManager_LRU do
+typedef struct simulator {
+	Configuration config;
+	Statistics statistics;
+
+	// Page Table
+	int frameNumber[PagesAmount];
+
+	// TLB (FIFO: queue of slots in fill order; LRU: last use of every slot)
+	int *TLBPageNumber, *TLBFrameNumber;
+	int *TLBFIFO;
+	unsigned long long *TLBLastUse;
+
+	// Memory (page of every frame). Both policies replace the frame loaded the
+	// longest ago: MemoryManager_LRU ages a frame only when a page is loaded on it
+	int *framePage;
+	int usedFrames, nextVictim;
+
+	unsigned long long clock;
+} Simulator;
+
+// Worker - Deque of configuration indexes owned by one thread
+typedef struct worker {
+	pthread_mutex_t mutex;
+	int jobs[MaxConfigurations];
+	int head, tail;
+	int id;
+} Worker;
+
+/**
+ * 	Program Global Variables
+ */
+// Every combination of these values is simulated once (the command line
+// replaces any of the lists)
+SweepList _sweepFrames = {{16, 32, 64, 128, 256}, 5};
+SweepList _sweepTLBEntries = {{4, 8, 16, 32}, 4};
+SweepList _sweepPolicies = {{FIFOPolicy, LRUPolicy}, 2};
+
+Trace *_trace;			// Parsed once and shared by every simulator
+Configuration _configurations[MaxConfigurations];
+Statistics _results[MaxConfigurations];
+int _configurationsAmount;
+Worker _workers[MaxThreads];
+int _workersAmount;
+
+/**
+ * 	Simulator methods
+ */
+// Creating a simulator for one configuration
+Simulator *createSimulator(Configuration config)
+{
+	Simulator *sim = (Simulator*)calloc(1, sizeof(Simulator));
+	sim->config = config;
+
+	sim->TLBPageNumber = (int*)malloc(config.TLBEntriesAmount*sizeof(int));
+	sim->TLBFrameNumber = (int*)malloc(config.TLBEntriesAmount*sizeof(int));
+	sim->TLBFIFO = (int*)malloc(config.TLBEntriesAmount*sizeof(int));
+	sim->TLBLastUse = (unsigned long long*)calloc(config.TLBEntriesAmount, sizeof(unsigned long long));
+	sim->framePage = (int*)malloc(config.framesAmount*sizeof(int));
+
+	for (int i = 0; i < PagesAmount; i++)
+		sim->frameNumber[i] = -1;
+	for (int i = 0; i < config.TLBEntriesAmount; i++)
+		sim->TLBPageNumber[i] = sim->TLBFrameNumber[i] = sim->TLBFIFO[i] = -1;
+	for (int i = 0; i < config.framesAmount; i++)
+		sim->framePage[i] = -1;
+	return sim;
+}
+
+// Destroying a simulator
+void destroySimulator(Simulator *sim)
+{
+	free(sim->TLBPageNumber);
+	free(sim->TLBFrameNumber);
+	free(sim->TLBFIFO);
+	free(sim->TLBLastUse);
+	free(sim->framePage);
+	free(sim);
+}
+
+// Finding Requested Page on TLB
+int findPageOnTLB(Simulator *sim, int pageNumber)
+{
+	for (int i = 0; i < sim->config.TLBEntriesAmount; i++)
+		if (sim->TLBPageNumber[i] == pageNumber) {
+			sim->statistics.TLBHitsCounter++;
+			if (sim->config.policy == LRUPolicy)
+				sim->TLBLastUse[i] = sim->clock;
+			return sim->TLBFrameNumber[i];
+		}
+
+	// Requested Page not found on TLB.
+	return -1;
+}
+
+// Setting Used Page on TLB
+void setPageOnTLB(Simulator *sim, int pageNumber, int frameNumber)
+{
+	int index = 0, entries = sim->config.TLBEntriesAmount;
+	if (sim->config.policy == FIFOPolicy) {
+		// The first free slot while the queue fills up (invalidated slots too),
+		// then the slot at the head of the queue
+		if (sim->TLBFIFO[0] == -1) {
+			for (int i = 0; i < entries; i++)
+				if (sim->TLBPageNumber[i] == -1) {
+					index = i;
+					break;
+				}
+		}
+		else
+			index = sim->TLBFIFO[0];
+		memmove(sim->TLBFIFO, sim->TLBFIFO + 1, (entries - 1)*sizeof(int));
+		sim->TLBFIFO[entries - 1] = index;
+	}
+	else {
+		// Empty or invalidated slots have the oldest use
+		for (int i = 1; i < entries; i++)
+			if (sim->TLBLastUse[i] < sim->TLBLastUse[index])
+				index = i;
+		sim->TLBLastUse[index] = sim->clock;
+	}
+	sim->TLBPageNumber[index] = pageNumber;
+	sim->TLBFrameNumber[index] = frameNumber;
+}
+
+// Invalidating an evicted Page on TLB
+void invalidatePageOnTLB(Simulator *sim, int pageNumber)
+{
+	for (int i = 0; i < sim->config.TLBEntriesAmount; i++)
+		if (sim->TLBPageNumber[i] == pageNumber) {
+			sim->TLBPageNumber[i] = sim->TLBFrameNumber[i] = -1;
+			sim->TLBLastUse[i] = 0;
+		}
+}
+
+// Find Frame on memory, evicting a victim when memory is full
+int findFrameOnMemory(Simulator *sim)
+{
+	int chosenFrame;
+
+	// There is available memory
+	if (sim->usedFrames < sim->config.framesAmount)
+		chosenFrame = sim->usedFrames++;
+	// Victim: frames are refilled in the order they were loaded
+	else {
+		chosenFrame = sim->nextVictim;
+		sim->nextVictim = (sim->nextVictim + 1) % sim->config.framesAmount;
+	}
+
+	// Invalidate overwritten page on Page Table and TLB
+	int evictedPage = sim->framePage[chosenFrame];
+	if (evictedPage != -1) {
+		sim->frameNumber[evictedPage] = -1;
+		invalidatePageOnTLB(sim, evictedPage);
+	}
+	return chosenFrame;
+}
+
+// Translating one page number
+void translatePage(Simulator *sim, int pageNumber)
+{
+	sim->clock++;
+
+	// Find frameNumber on TLB
+	int frameNumber = findPageOnTLB(sim, pageNumber);
+
+	// If TLB find fails
+	if (frameNumber == -1) {
+		// Find frameNumber on Page Table
+		frameNumber = sim->frameNumber[pageNumber];
+
+		// If Page Fault
+		if (frameNumber == -1) {
+			sim->statistics.PageFaultsCounter++;
+			frameNumber = findFrameOnMemory(sim);
+			sim->frameNumber[pageNumber] = frameNumber;
+			sim->framePage[frameNumber] = pageNumber;
+		}
+		setPageOnTLB(sim, pageNumber, frameNumber);
+	}
+	sim->statistics.TranslatedAddressesCounter++;
+}
+
+// Running one configuration over the shared trace
+Statistics runConfiguration(Configuration config)
+{
+	Simulator *sim = createSimulator(config);
+	for (long long i = 0; i < _trace->length; i++)
+		translatePage(sim, (_trace->virtualAddress[i] & TraceAddressMask)/FrameBytesSize);
+
+	Statistics statistics = sim->statistics;
+	destroySimulator(sim);
+	return statistics;
+}
+
+/**
+ * 	Work Stealing methods
+ */
+// Popping a job from the owner's end of the deque
+int popJob(Worker *worker)
+{
+	int job = -1;
+	pthread_mutex_lock(&worker->mutex);
+	if (worker->head < worker->tail)
+		job = worker->jobs[--worker->tail];
+	pthread_mutex_unlock(&worker->mutex);
+	return job;
+}
+
+// Stealing a job from the opposite end of another worker's deque
+int stealJob(Worker *worker)
+{
+	int job = -1;
+	pthread_mutex_lock(&worker->mutex);
+	if (worker->head < worker->tail)
+		job = worker->jobs[worker->head++];
+	pthread_mutex_unlock(&worker->mutex);
+	return job;
+}
+
+void *thread_sweep(void *arg)
+{
+	Worker *worker = (Worker*)arg;
+
+	for (;;) {
+		int job = popJob(worker);
+
+		// Own deque is empty: try every other worker once
+		for (int i = 1; job == -1 && i < _workersAmount; i++)
+			job = stealJob(&_workers[(worker->id + i) % _workersAmount]);
+
+		// Nothing left anywhere
+		if (job == -1)
+			return NULL;
+
+		_results[job] = runConfiguration(_configurations[job]);
+	}
+}
+
+/**
+ * 	Sweep methods
+ */
+// Parsing a comma separated list of sizes (1..PagesAmount) or of policy
+// names (FIFO, LRU); 0 when a value is invalid or there are too many
+int parseSweepList(char *text, SweepList *list, int policies)
+{
+	int maxValues = policies ? PoliciesAmount : MaxSweepValues;
+	list->amount = 0;
+	for (char *value = strtok(text, ","); value != NULL; value = strtok(NULL, ",")) {
+		int parsed;
+		if (policies)
+			parsed = strcmp(value, "FIFO") == 0 ? FIFOPolicy : strcmp(value, "LRU") == 0 ? LRUPolicy : -1;
+		else
+			parsed = atoi(value) >= 1 && atoi(value) <= PagesAmount ? atoi(value) : -1;
+
+		if (parsed == -1 || list->amount == maxValues)
+			return 0;
+		list->value[list->amount++] = parsed;
+	}
+	return list->amount > 0;
+}
+
+// Building every (frames, TLB entries, policy) combination
+void buildConfigurations()
+{
+	int job = 0;
+	for (int p = 0; p < _sweepPolicies.amount; p++)
+		for (int f = 0; f < _sweepFrames.amount; f++)
+			for (int t = 0; t < _sweepTLBEntries.amount; t++) {
+				_configurations[job].framesAmount = _sweepFrames.value[f];
+				_configurations[job].TLBEntriesAmount = _sweepTLBEntries.value[t];
+				_configurations[job].policy = _sweepPolicies.value[p];
+				job++;
+			}
+	_configurationsAmount = job;
+}
+
+// Distributing jobs round robin and running the workers
+void runSweep()
+{
+	pthread_t threads[MaxThreads];
+
+	_workersAmount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (_workersAmount < 1)						_workersAmount = 1;
+	if (_workersAmount > MaxThreads)			_workersAmount = MaxThreads;
+	if (_workersAmount > _configurationsAmount)	_workersAmount = _configurationsAmount;
+
+	for (int i = 0; i < _workersAmount; i++) {
+		pthread_mutex_init(&_workers[i].mutex, NULL);
+		_workers[i].head = _workers[i].tail = 0;
+		_workers[i].id = i;
+	}
+	for (int job = 0; job < _configurationsAmount; job++) {
+		Worker *worker = &_workers[job % _workersAmount];
+		worker->jobs[worker->tail++] = job;
+	}
+
+	for (int i = 0; i < _workersAmount; i++)
+		pthread_create(&threads[i], NULL, thread_sweep, &_workers[i]);
+	for (int i = 0; i < _workersAmount; i++) {
+		pthread_join(threads[i], NULL);
+		pthread_mutex_destroy(&_workers[i].mutex);
+	}
+}
+
+// Sweep Output Table
+void sweepLog(char *resultfile)
+{
+	FILE *result = fopen(resultfile, "w");
+
+	fprintf(result, "Number of Translated Addresses = %lld\n", _trace->length);
+	fprintf(result, "%-6s %6s %4s %11s %15s %8s %12s\n",
+		"Policy", "Frames", "TLB", "Page Faults", "Page Fault Rate", "TLB Hits", "TLB Hit Rate");
+
+	for (int job = 0; job < _configurationsAmount; job++) {
+		Statistics *statistics = &_results[job];
+		float pageFaultRate = statistics->PageFaultsCounter;
+			  pageFaultRate = pageFaultRate/statistics->TranslatedAddressesCounter;
+		float tlbHitsRate = statistics->TLBHitsCounter;
+			  tlbHitsRate = tlbHitsRate/statistics->TranslatedAddressesCounter;
+
+		fprintf(result, "%-6s %6d %4d %11lld %15.3f %8lld %12.3f\n",
+			_configurations[job].policy == FIFOPolicy ? "FIFO" : "LRU",
+			_configurations[job].framesAmount, _configurations[job].TLBEntriesAmount,
+			statistics->PageFaultsCounter, pageFaultRate,
+			statistics->TLBHitsCounter, tlbHitsRate);
+	}
+	fclose(result);
+}
+
+/**
+ * 	Main Configuration Sweep
+ *
+ *	MemoryManager_Sweep [-f frames,...] [-t entries,...] [-p FIFO,LRU] [addresses]
+ */
+int main(int arc, char** argv)
+{
+	char *inputfile = inputfile_default;
+	int valid = 1;
+
+	for (int i = 1; i < arc && valid; i++) {
+		if (strcmp(argv[i], "-f") == 0 && i + 1 < arc)
+			valid = parseSweepList(argv[++i], &_sweepFrames, 0);
+		else if (strcmp(argv[i], "-t") == 0 && i + 1 < arc)
+			valid = parseSweepList(argv[++i], &_sweepTLBEntries, 0);
+		else if (strcmp(argv[i], "-p") == 0 && i + 1 < arc)
+			valid = parseSweepList(argv[++i], &_sweepPolicies, 1);
+		else
+			inputfile = argv[i];
+	}
+	if (!valid) {
+		fprintf(stderr, "Lists take up to %d comma separated sizes (1 to %d) or policies (FIFO, LRU)\n",
+			MaxSweepValues, PagesAmount);
+		return 1;
+	}
+
+	_trace = loadTrace(inputfile, 0);
+	if (_trace->length == 0) {
+		fprintf(stderr, "Empty trace\n");
+		return 1;
+	}
+
+	buildConfigurations();
+	runSweep();
+	sweepLog(result_default);
+
+	freeTrace(_trace);
+	return 0;
+}
@@ -0,0 +1,146 @@
+/**
+ * CES-33 Final Project
+ *
+ *  Memory Manager Simulator - Whole Trace Loader
+ *
+ *  Felipe Tuyama de F. Barbosa
+ *	Luiz Angel Rocha Rafael
+ *
+ *	Loads a trace once for the tools that go over it many times or from many
+ *	threads (MemoryManager_Sweep, MemoryManager_StackDistance and
+ *	MemoryManager_Concurrent): "address [R|W [value]]" lines, or a binary
+ *	trace of MemoryManager_TraceGenerator -b. Like the simulators, binary
+ *	addresses above 16 bits are refused, and text ones are kept as written.
+ */
+#ifndef MEMORYMANAGER_TRACE_H
+#define MEMORYMANAGER_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * 	Trace Defines
+ */
+#define TraceLineLength		16
+#define TraceAddressMask	0xFFFF		// 16 bit virtual addresses
+
+// Binary traces: magic, version, reference count and one uint32 per address
+#define TraceMagic			"MMTR"
+#define TraceHeaderBytes	16
+
+// Access Types (the same as libmemmgr.h)
+#ifndef ReadAccess
+#define ReadAccess			0
+#define WriteAccess			1
+#define RewriteAccess		2
+#endif
+
+/**
+ * 	Trace Structs
+ */
+// Trace - References parsed once (access and writeValue only when loaded with accesses)
+typedef struct trace {
+	int *virtualAddress;
+	char *access;
+	int *writeValue;
+	long long length;
+} Trace;
+
+/**
+ * 	Trace methods
+ */
+// Adding a reference to the trace
+static void addReference(Trace *trace, long long *capacity, int virtualAddress, char access, int writeValue)
+{
+	if (trace->length == *capacity) {
+		*capacity *= 2;
+		trace->virtualAddress = (int*)realloc(trace->virtualAddress, *capacity*sizeof(int));
+		if (trace->access) {
+			trace->access = (char*)realloc(trace->access, *capacity*sizeof(char));
+			trace->writeValue = (int*)realloc(trace->writeValue, *capacity*sizeof(int));
+		}
+	}
+	trace->virtualAddress[trace->length] = virtualAddress;
+	if (trace->access) {
+		trace->access[trace->length] = access;
+		trace->writeValue[trace->length] = writeValue;
+	}
+	trace->length++;
+}
+
+// Loading the references of a binary trace (after its magic)
+static void loadBinaryTrace(FILE *addresses, Trace *trace, long long *capacity)
+{
+	uint32_t version, buffer[4096];
+	uint64_t references;
+	if (fread(&version, sizeof(version), 1, addresses) != 1
+		|| fread(&references, sizeof(references), 1, addresses) != 1) {
+		fprintf(stderr, "Truncated binary trace\n");
+		exit(1);
+	}
+
+	size_t read;
+	while (trace->length < (long long)references
+		&& (read = fread(buffer, sizeof(uint32_t), 4096, addresses)) > 0)
+		for (size_t i = 0; i < read && trace->length < (long long)references; i++) {
+			if (buffer[i] > TraceAddressMask) {
+				fprintf(stderr, "Address %u out of range at byte %lld of the binary trace\n",
+					buffer[i], TraceHeaderBytes + 4*trace->length);
+				exit(1);
+			}
+			addReference(trace, capacity, buffer[i], ReadAccess, 0);
+		}
+}
+
+// Loading and parsing the whole trace once. Without accesses every reference
+// is a read and only the addresses are kept
+static Trace *loadTrace(const char *inputfile, int withAccesses)
+{
+	FILE *addresses = fopen(inputfile, "rb");
+	if (addresses == NULL) {
+		fprintf(stderr, "Could not open %s\n", inputfile);
+		exit(1);
+	}
+
+	Trace *trace = (Trace*)calloc(1, sizeof(Trace));
+	long long capacity = 1024;
+	trace->virtualAddress = (int*)malloc(capacity*sizeof(int));
+	if (withAccesses) {
+		trace->access = (char*)malloc(capacity*sizeof(char));
+		trace->writeValue = (int*)malloc(capacity*sizeof(int));
+	}
+
+	char magic[4];
+	if (fread(magic, 1, 4, addresses) == 4 && memcmp(magic, TraceMagic, 4) == 0)
+		loadBinaryTrace(addresses, trace, &capacity);
+	else {
+		rewind(addresses);
+		char line[TraceLineLength] = "";
+		while (fgets(line, TraceLineLength, addresses)) {
+			int virtualAddress = 0, writeValue = 0;
+			char access = 'R';
+			int fields = sscanf(line, "%d %c %d", &virtualAddress, &access, &writeValue);
+
+			// Without a value the byte is rewritten as is
+			char accessType = ReadAccess;
+			if (fields >= 2 && (access == 'W' || access == 'w'))
+				accessType = fields < 3 ? RewriteAccess : WriteAccess;
+			addReference(trace, &capacity, virtualAddress, accessType, writeValue);
+		}
+	}
+	fclose(addresses);
+	return trace;
+}
+
+// Releasing a trace
+static void freeTrace(Trace *trace)
+{
+	free(trace->virtualAddress);
+	free(trace->access);
+	free(trace->writeValue);
+	free(trace);
+}
+
+#endif
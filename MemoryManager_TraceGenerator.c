@@ -0,0 +1,388 @@
+/**
+ * CES-33 Final Project
+ *
+ *  Memory Manager Simulator - Synthetic Trace Generator
+ *
+ *  Felipe Tuyama de F. Barbosa
+ *	Luiz Angel Rocha Rafael
+ */
+
+/**
+ * 	Memory Manager Includes
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/**
+ * 	Memory Manager Defines
+ */
+// Max Number Definitions
+#define MaxThreads			64
+#define MaxLineLength		8			// "262143\n": segment, page and offset
+
+// Virtual Memory Pages
+#define PagesAmount			256
+#define FrameBytesSize		256
+#define AddressSpaceSize	(PagesAmount*FrameBytesSize)
+
+// Segmentation (segment number above the page number, as in the Exame layout)
+#define SegmentsAmount		4
+
+// Generation (references are produced in fixed chunks, so the output does
+// not depend on the number of threads)
+#define ChunkReferences		(1 << 20)
+
+// Binary trace: "MMTR", version, reference count, then one uint32 per address
+#define TraceMagic			"MMTR"
+#define TraceVersion		1
+
+// Locality Models
+#define UniformModel		0
+#define ZipfModel			1		// Static hot set
+#define PhasesModel			2		// Hot set moves every PhaseLength references
+#define SequentialModel		3		// Scan of the whole address space
+#define LoopModel			4		// Scan of the first LoopPages pages, repeated
+#define StrideModel			5		// One reference every StridePages pages
+#define SegmentsModel		6		// Code, heap, stack and data segments mixed
+#define ModelsAmount		7
+
+// Model parameters defaults
+#define ZipfExponent_default	0.99
+#define PhaseLength_default		100000
+#define PhaseShift				61		// Pages the hot set moves at each phase
+#define ScanStep_default		16		// Bytes between sequential references
+#define LoopPages_default		32
+#define StridePages_default		7
+
+// Files
+#define textfile_default 	"trace.txt"
+#define binaryfile_default 	"trace.bin"
+
+const char *modelNames[ModelsAmount] = {"uniform", "zipf", "phases", "sequential", "loop", "stride", "segments"};
+
+// Segments mix: weight (%) and model of each segment
+const int segmentWeights[SegmentsAmount] = {40, 30, 20, 10};
+const int segmentModels[SegmentsAmount] = {LoopModel, ZipfModel, LoopModel, UniformModel};
+const int segmentLoopPages[SegmentsAmount] = {32, 0, 4, 0};
+
+/**
+ * 	Memory Manager Structs
+ */
+// Generator Configuration
+typedef struct generator {
+	int model;
+	long long references;
+	unsigned long long seed;
+	int binary;
+	int threads;
+
+	double zipfExponent;
+	long long phaseLength;
+	int scanStep;
+	int loopPages;
+	int stridePages;
+
+	// Zipf sampling: CDF over popularity ranks, ranks scattered over the pages
+	double zipfCDF[PagesAmount];
+	int hotPages[PagesAmount];
+} Generator;
+
+// Chunk - References generated by one thread
+typedef struct chunk {
+	long long first, count;
+	uint32_t *address;
+	char *text;
+	size_t textLength;
+} Chunk;
+
+/**
+ * 	Program Global Variables
+ */
+Generator _generator;
+Chunk _chunks[MaxThreads];
+
+/**
+ * 	Random Number methods
+ */
+// SplitMix64, used to derive independent seeds
+unsigned long long splitMix(unsigned long long x)
+{
+	x += 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+// Xorshift64* generator
+unsigned long long nextRandom(unsigned long long *state)
+{
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform double in [0, 1)
+double nextUniform(unsigned long long *state)
+{
+	return (nextRandom(state) >> 11) * (1.0/9007199254740992.0);
+}
+
+/**
+ * 	Locality Model methods
+ */
+// Preparing the Zipf CDF and the seeded placement of the hot pages
+void prepareGenerator()
+{
+	double sum = 0;
+	for (int i = 0; i < PagesAmount; i++)
+		sum += 1.0/pow(i + 1, _generator.zipfExponent);
+	for (int i = 0; i < PagesAmount; i++)
+		_generator.zipfCDF[i] = (i ? _generator.zipfCDF[i-1] : 0) + 1.0/pow(i + 1, _generator.zipfExponent)/sum;
+
+	unsigned long long state = splitMix(_generator.seed) | 1;
+	for (int i = 0; i < PagesAmount; i++)
+		_generator.hotPages[i] = i;
+	for (int i = PagesAmount - 1; i > 0; i--) {
+		int j = nextRandom(&state) % (i + 1);
+		int swap = _generator.hotPages[i];
+		_generator.hotPages[i] = _generator.hotPages[j];
+		_generator.hotPages[j] = swap;
+	}
+}
+
+// Sampling a page from the Zipf hot set
+int zipfPage(unsigned long long *state)
+{
+	double u = nextUniform(state);
+	int low = 0, high = PagesAmount - 1;
+	while (low < high) {
+		int mid = (low + high)/2;
+		if (_generator.zipfCDF[mid] < u)	low = mid + 1;
+		else								high = mid;
+	}
+	return _generator.hotPages[low];
+}
+
+// Virtual address of reference i under a model (without segment)
+uint32_t modelAddress(int model, long long i, int loopPages, unsigned long long *state)
+{
+	int offset = nextRandom(state) % FrameBytesSize;
+
+	switch (model) {
+	case ZipfModel:
+		return zipfPage(state)*FrameBytesSize + offset;
+	case PhasesModel: {
+		long long phase = i / _generator.phaseLength;
+		int page = (zipfPage(state) + phase*PhaseShift) % PagesAmount;
+		return page*FrameBytesSize + offset;
+	}
+	case SequentialModel:
+		return (i*_generator.scanStep) % AddressSpaceSize;
+	case LoopModel:
+		return (i*_generator.scanStep) % (loopPages*FrameBytesSize);
+	case StrideModel:
+		return ((i*_generator.stridePages) % PagesAmount)*FrameBytesSize + offset;
+	default:
+		return nextRandom(state) % AddressSpaceSize;
+	}
+}
+
+// Virtual address of reference i
+uint32_t generateAddress(long long i, unsigned long long *state)
+{
+	if (_generator.model != SegmentsModel)
+		return modelAddress(_generator.model, i, _generator.loopPages, state);
+
+	// Segment chosen by weight, page by the model of that segment
+	int draw = nextRandom(state) % 100, segment = 0;
+	while (draw >= segmentWeights[segment]) {
+		draw -= segmentWeights[segment];
+		segment++;
+	}
+	uint32_t address = modelAddress(segmentModels[segment], i, segmentLoopPages[segment], state);
+	return (uint32_t)segment*AddressSpaceSize + address;
+}
+
+/**
+ * 	Generation methods
+ */
+// Formatting a chunk as text lines
+void formatChunk(Chunk *chunk)
+{
+	char *out = chunk->text;
+	for (long long i = 0; i < chunk->count; i++) {
+		char digits[12];
+		int length = 0;
+		uint32_t address = chunk->address[i];
+		do {
+			digits[length++] = '0' + address % 10;
+			address /= 10;
+		} while (address);
+		while (length)
+			*out++ = digits[--length];
+		*out++ = '\n';
+	}
+	chunk->textLength = out - chunk->text;
+}
+
+// Thread generating one chunk
+void *thread_generateChunk(void *arg)
+{
+	Chunk *chunk = (Chunk*)arg;
+
+	// The chunk seed only depends on the global seed and the chunk position
+	unsigned long long state = splitMix(_generator.seed ^ splitMix(chunk->first / ChunkReferences)) | 1;
+	for (long long i = 0; i < chunk->count; i++)
+		chunk->address[i] = generateAddress(chunk->first + i, &state);
+
+	if (!_generator.binary)
+		formatChunk(chunk);
+	return NULL;
+}
+
+// Writing the binary trace header
+void writeHeader(FILE *output)
+{
+	uint32_t version = TraceVersion;
+	uint64_t references = _generator.references;
+	fwrite(TraceMagic, 1, 4, output);
+	fwrite(&version, sizeof(version), 1, output);
+	fwrite(&references, sizeof(references), 1, output);
+}
+
+// Generating the whole trace, threads chunks at a time
+void generateTrace(FILE *output)
+{
+	pthread_t threads[MaxThreads];
+
+	for (int t = 0; t < _generator.threads; t++) {
+		_chunks[t].address = (uint32_t*)malloc(ChunkReferences*sizeof(uint32_t));
+		_chunks[t].text = _generator.binary ? NULL : (char*)malloc((size_t)ChunkReferences*MaxLineLength);
+	}
+
+	if (_generator.binary)
+		writeHeader(output);
+
+	for (long long first = 0; first < _generator.references; first += (long long)_generator.threads*ChunkReferences) {
+		int running = 0;
+		for (int t = 0; t < _generator.threads; t++) {
+			long long chunkFirst = first + (long long)t*ChunkReferences;
+			if (chunkFirst >= _generator.references)
+				break;
+			_chunks[t].first = chunkFirst;
+			_chunks[t].count = _generator.references - chunkFirst;
+			if (_chunks[t].count > ChunkReferences)
+				_chunks[t].count = ChunkReferences;
+			pthread_create(&threads[t], NULL, thread_generateChunk, &_chunks[t]);
+			running++;
+		}
+
+		// Chunks are written in order
+		for (int t = 0; t < running; t++) {
+			pthread_join(threads[t], NULL);
+			if (_generator.binary)
+				fwrite(_chunks[t].address, sizeof(uint32_t), _chunks[t].count, output);
+			else
+				fwrite(_chunks[t].text, 1, _chunks[t].textLength, output);
+		}
+	}
+
+	for (int t = 0; t < _generator.threads; t++) {
+		free(_chunks[t].address);
+		free(_chunks[t].text);
+	}
+}
+
+/**
+ * 	Main Trace Generator
+ *
+ *	MemoryManager_TraceGenerator [-m model] [-n references] [-s seed] [-b] [-o file] [-j threads]
+ *		[-a zipfExponent] [-p phaseLength] [-step bytes] [-loop pages] [-stride pages]
+ *
+ *	Every model but segments stays in the 16 bit virtual space. Segments
+ *	addresses have 18 bits (segment above the page number) and are meant for
+ *	MemoryManager_Exame, so they are text only. MemoryManager_FIFO/LRU
+ *	translate only their low 16 bits.
+ */
+int main(int arc, char** argv)
+{
+	char *outputfile = NULL;
+
+	_generator.model = ZipfModel;
+	_generator.references = 1000000;
+	_generator.seed = 1;
+	_generator.threads = sysconf(_SC_NPROCESSORS_ONLN);
+	_generator.zipfExponent = ZipfExponent_default;
+	_generator.phaseLength = PhaseLength_default;
+	_generator.scanStep = ScanStep_default;
+	_generator.loopPages = LoopPages_default;
+	_generator.stridePages = StridePages_default;
+
+	for (int i = 1; i < arc; i++) {
+		char *value = i + 1 < arc ? argv[i+1] : NULL;
+		if (strcmp(argv[i], "-b") == 0) {
+			_generator.binary = 1;
+			continue;
+		}
+		if (value == NULL) {
+			fprintf(stderr, "Missing value for %s\n", argv[i]);
+			return 1;
+		}
+		i++;
+
+		if (strcmp(argv[i-1], "-m") == 0) {
+			_generator.model = -1;
+			for (int m = 0; m < ModelsAmount; m++)
+				if (strcmp(value, modelNames[m]) == 0)
+					_generator.model = m;
+			if (_generator.model == -1) {
+				fprintf(stderr, "Unknown model %s\n", value);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i-1], "-n") == 0)		_generator.references = atoll(value);
+		else if (strcmp(argv[i-1], "-s") == 0)		_generator.seed = strtoull(value, NULL, 10);
+		else if (strcmp(argv[i-1], "-o") == 0)		outputfile = value;
+		else if (strcmp(argv[i-1], "-j") == 0)		_generator.threads = atoi(value);
+		else if (strcmp(argv[i-1], "-a") == 0)		_generator.zipfExponent = atof(value);
+		else if (strcmp(argv[i-1], "-p") == 0)		_generator.phaseLength = atoll(value);
+		else if (strcmp(argv[i-1], "-step") == 0)	_generator.scanStep = atoi(value);
+		else if (strcmp(argv[i-1], "-loop") == 0)	_generator.loopPages = atoi(value);
+		else if (strcmp(argv[i-1], "-stride") == 0)	_generator.stridePages = atoi(value);
+		else {
+			fprintf(stderr, "Unknown option %s\n", argv[i-1]);
+			return 1;
+		}
+	}
+
+	if (_generator.threads < 1)				_generator.threads = 1;
+	if (_generator.threads > MaxThreads)	_generator.threads = MaxThreads;
+	if (_generator.phaseLength < 1)			_generator.phaseLength = 1;
+	if (_generator.scanStep < 1)			_generator.scanStep = 1;
+	if (_generator.loopPages < 1 || _generator.loopPages > PagesAmount)
+		_generator.loopPages = LoopPages_default;
+	if (_generator.binary && _generator.model == SegmentsModel) {
+		fprintf(stderr, "Segments traces are for MemoryManager_Exame, which reads text traces only\n");
+		return 1;
+	}
+	if (outputfile == NULL)
+		outputfile = _generator.binary ? binaryfile_default : textfile_default;
+
+	FILE *output = fopen(outputfile, _generator.binary ? "wb" : "w");
+	if (output == NULL) {
+		fprintf(stderr, "Could not open %s\n", outputfile);
+		return 1;
+	}
+
+	prepareGenerator();
+	generateTrace(output);
+	fclose(output);
+	return 0;
+}
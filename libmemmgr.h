@@ -0,0 +1,126 @@
+/**
+ * CES-33 Final Project
+ *
+ *  Memory Manager Library (libmemmgr)
+ *
+ *  Felipe Tuyama de F. Barbosa
+ *	Luiz Angel Rocha Rafael
+ *
+ *	Every table, buffer and file of a simulated memory lives on its own
+ *	MemoryManager context, so one process may run many of them. A context is
+ *	used by one thread at a time; different contexts run on different threads
+ *	at the same time. Virtual addresses are 16 bits: the bits above them are
+ *	ignored.
+ *
+ *	MemoryManager *manager = memoryManagerCreate("BACKING_STORE.bin", NULL);
+ *	int value, physicalAddress = memoryManagerTranslate(manager, 16916, ReadAccess, 0, &value);
+ *	memoryManagerDestroy(manager);
+ */
+#ifndef LIBMEMMGR_H
+#define LIBMEMMGR_H
+
+#include <stdio.h>
+
+#define MemoryManagerAPI	__attribute__((visibility("default")))
+
+/**
+ * 	Access Types
+ */
+#define ReadAccess			0
+#define WriteAccess			1		// Stores the given value
+#define RewriteAccess		2		// Stores the byte already there (page becomes dirty)
+
+/**
+ * 	Library Structs
+ */
+// Statistics
+typedef struct statistics {
+	long long TranslatedAddressesCounter;
+	long long PageFaultsCounter;
+	long long TLBHitsCounter;
+	long long WritesCounter;
+	long long DirtyEvictionsCounter;
+	long long CoalescedWriteBacksCounter;
+	long long BackingStoreWritesCounter;
+	long long PrefetchedPagesCounter;
+	long long PrefetchReadsCounter;
+	long long UsefulPrefetchesCounter;
+	long long WastedPrefetchesCounter;
+	long long EvictionsCounter;
+	long long DeviceRequestsCounter;
+	long long SimulatedTime;				// Nanoseconds of the simulated clock
+	long long FaultStallTime;				// Nanoseconds waiting for the storage device
+	long long PoolStoresCounter;			// Evicted pages kept on the compressed pool
+	long long PoolRejectedCounter;
+	long long PoolHitsCounter;
+	long long PoolWriteBacksCounter;
+	long long PoolStoredBytes;				// Uncompressed bytes of the pages stored
+	long long PoolCompressedBytes;
+	long long LocalAccessesCounter;			// Data accesses by NUMA node of the CPU
+	long long RemoteAccessesCounter;
+	long long MigrationsCounter;
+	long long PageWalksCounter;				// TLB misses walking a multi-level Page Table
+	long long WalkCacheHitsCounter;			// Walks skipping upper levels
+	long long WalkMemoryAccessesCounter;
+	long long TLBPrefetchesCounter;			// Translations inserted by the TLB prefetcher
+	long long UsefulTLBPrefetchesCounter;	// TLB misses eliminated
+	long long ReferencesCounter;			// Every reference since creation (kept when the statistics start over)
+} Statistics;
+
+// Memory Manager context (opaque)
+typedef struct memoryManager MemoryManager;
+
+/**
+ * 	Library methods
+ */
+// Creating a Memory Manager over a copy of backingStoreFile, written on
+// backingStoreCopyFile (a temporary file when NULL). NULL on failure
+MemoryManagerAPI MemoryManager *memoryManagerCreate(const char *backingStoreFile, const char *backingStoreCopyFile);
+
+// Translating one reference: returns the physical address, value receives the byte
+MemoryManagerAPI int memoryManagerTranslate(MemoryManager *manager, int virtualAddress, int access,
+	int writeValue, int *value);
+
+// Translating count references in order. accesses and writeValues may be NULL for reads only
+MemoryManagerAPI void memoryManagerTranslateBatch(MemoryManager *manager, int count, const int *virtualAddresses,
+	const char *accesses, const int *writeValues, int *physicalAddresses, int *values);
+
+// Copying the statistics so far
+MemoryManagerAPI void memoryManagerStatistics(MemoryManager *manager, Statistics *statistics);
+
+// Writing every dirty resident page on the Backing Store copy
+MemoryManagerAPI void memoryManagerSync(MemoryManager *manager);
+
+// Starting the statistics over (after a warm-up prefix), keeping the whole
+// state and ReferencesCounter
+MemoryManagerAPI void memoryManagerResetStatistics(MemoryManager *manager);
+
+// Functional warming: translations keep tables, queues and frames up to date,
+// but the timing model stands still. Off by default
+MemoryManagerAPI void memoryManagerSetWarming(MemoryManager *manager, int warming);
+
+// Writing the output files of a context (timeseries, heatmap.csv and
+// reuse.csv) with prefix before their names, like "run1/" or "lru-", so
+// contexts of one process keep their own. Empty by default
+MemoryManagerAPI void memoryManagerSetOutputPrefix(MemoryManager *manager, const char *prefix);
+
+// Running the next translations on a CPU of node (NUMA builds, node 0 by
+// default). First touch places new pages there
+MemoryManagerAPI void memoryManagerSetNode(MemoryManager *manager, int node);
+
+// Writing the statistics log on output
+MemoryManagerAPI void memoryManagerLog(MemoryManager *manager, FILE *output);
+
+// Saving the whole state (tables, frames, queues, statistics and the Backing
+// Store copy) with tracePosition, the caller's position on its trace. 0 on success
+MemoryManagerAPI int memoryManagerCheckpoint(MemoryManager *manager, const char *checkpointFile, long long tracePosition);
+
+// Creating a Memory Manager from a checkpoint of a simulator with the same
+// policy and sizes. tracePosition receives the saved position. NULL on failure
+MemoryManagerAPI MemoryManager *memoryManagerRestore(const char *checkpointFile, const char *backingStoreFile,
+	const char *backingStoreCopyFile, long long *tracePosition);
+
+// Destroying a Memory Manager (dirty pages not synced are lost)
+MemoryManagerAPI void memoryManagerDestroy(MemoryManager *manager);
+
+#endif
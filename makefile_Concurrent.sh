@@ -0,0 +1,14 @@
+#! /bin/bash
+
+rm -rf MemoryManager_Concurrent.o MemoryManager_Concurrent
+gcc -std=c99 -Wall -c MemoryManager_Concurrent.c
+gcc MemoryManager_Concurrent.o -o MemoryManager_Concurrent -lpthread -lm
+
+if [ $# -eq 0 ]
+then
+	./MemoryManager_Concurrent
+else
+	./MemoryManager_Concurrent "$@"
+fi
+
+exit 0
\ No newline at end of file
@@ -1,8 +1,13 @@
 #! /bin/bash
 
 rm -rf *o MemoryManager_LRU
-gcc -std=c99 -Wall -c MemoryManager_LRU.c
-gcc MemoryManager_LRU.o -o MemoryManager_LRU -lpthread -lm
+# Compressed traces when zlib or libzstd are installed
+TRACEFLAGS=""; TRACELIBS=""
+if gcc -E -include zlib.h -x c /dev/null >/dev/null 2>&1; then TRACEFLAGS="$TRACEFLAGS -DTraceGzip=1"; TRACELIBS="$TRACELIBS -lz"; fi
+if gcc -E -include zstd.h -x c /dev/null >/dev/null 2>&1; then TRACEFLAGS="$TRACEFLAGS -DTraceZstd=1"; TRACELIBS="$TRACELIBS -lzstd"; fi
+
+gcc -std=c99 -Wall $TRACEFLAGS -c MemoryManager_LRU.c
+gcc MemoryManager_LRU.o -o MemoryManager_LRU -lpthread -lm $TRACELIBS
 
 if [ $# -eq 0 ]
 then
@@ -0,0 +1,14 @@
+#! /bin/bash
+
+rm -rf MemoryManager_StackDistance.o MemoryManager_StackDistance
+gcc -std=c99 -Wall -c MemoryManager_StackDistance.c
+gcc MemoryManager_StackDistance.o -o MemoryManager_StackDistance -lpthread -lm
+
+if [ $# -eq 0 ]
+then
+	./MemoryManager_StackDistance
+else
+	./MemoryManager_StackDistance $1
+fi
+
+exit 0
\ No newline at end of file
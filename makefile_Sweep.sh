@@ -0,0 +1,14 @@
+#! /bin/bash
+
+rm -rf MemoryManager_Sweep.o MemoryManager_Sweep
+gcc -std=c99 -Wall -c MemoryManager_Sweep.c
+gcc MemoryManager_Sweep.o -o MemoryManager_Sweep -lpthread -lm
+
+if [ $# -eq 0 ]
+then
+	./MemoryManager_Sweep
+else
+	./MemoryManager_Sweep $1
+fi
+
+exit 0
\ No newline at end of file
@@ -0,0 +1,9 @@
+#! /bin/bash
+
+rm -rf MemoryManager_TraceGenerator.o MemoryManager_TraceGenerator
+gcc -std=c99 -Wall -O2 -c MemoryManager_TraceGenerator.c
+gcc MemoryManager_TraceGenerator.o -o MemoryManager_TraceGenerator -lpthread -lm
+
+./MemoryManager_TraceGenerator "$@"
+
+exit 0
\ No newline at end of file